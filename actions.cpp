@@ -48,6 +48,19 @@ void Actions::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void Actions::clearScriptFile(const std::string& scriptFile)
+{
+	for (ActionUseMap* map : {&useItemMap, &uniqueItemMap, &actionItemMap}) {
+		for (auto it = map->begin(); it != map->end(); ) {
+			if (it->second.fromLua && it->second.scriptFile == scriptFile) {
+				it = map->erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
 LuaScriptInterface& Actions::getScriptInterface()
 {
 	return scriptInterface;
@@ -113,6 +113,7 @@ class Actions final : public BaseEvents
 
 		bool registerLuaEvent(Action* event);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 
 	private:
 		ReturnValue internalUseItem(Player* player, const Position& pos, uint8_t index, Item* item, bool isHotkey);
@@ -30,6 +30,8 @@ class Event
 
 		bool scripted = false;
 		bool fromLua = false;
+		// file the event was registered from, only set for events registered from lua
+		std::string scriptFile;
 
 		int32_t getScriptId() {
 			return scriptId;
@@ -55,6 +57,9 @@ class BaseEvents
 		}
 		void reInitState(bool fromLua);
 
+		// removes the lua registered events coming from scriptFile
+		virtual void clearScriptFile(const std::string& scriptFile) = 0;
+
 	private:
 		virtual LuaScriptInterface& getScriptInterface() = 0;
 		virtual std::string getScriptBaseName() const = 0;
@@ -5,6 +5,7 @@
 
 #include "bed.h"
 #include "game.h"
+#include "iodelivery.h"
 #include "iologindata.h"
 #include "scheduler.h"
 
@@ -167,14 +168,20 @@ void BedItem::wakeUp(Player* player)
 	}
 
 	if (sleeperGUID != 0) {
+		const uint32_t sleptTime = time(nullptr) - sleepStart;
 		if (!player) {
-			Player regenPlayer(nullptr);
-			if (IOLoginData::loadPlayerById(&regenPlayer, sleeperGUID)) {
-				regeneratePlayer(&regenPlayer);
-				IOLoginData::savePlayer(&regenPlayer);
-			}
+			// the sleeper is loaded and saved once the items and gold queued for it
+			// are written (e.g. by the eviction waking it up), or the save would undo them
+			const uint32_t guid = sleeperGUID;
+			IODelivery::whenDelivered(guid, [guid, sleptTime]() {
+				Player regenPlayer(nullptr);
+				if (IOLoginData::loadPlayerById(&regenPlayer, guid)) {
+					regeneratePlayer(&regenPlayer, sleptTime);
+					IOLoginData::savePlayer(&regenPlayer);
+				}
+			});
 		} else {
-			regeneratePlayer(player);
+			regeneratePlayer(player, sleptTime);
 			g_game.addCreatureHealth(player);
 		}
 	}
@@ -199,10 +206,8 @@ void BedItem::wakeUp(Player* player)
 	}
 }
 
-void BedItem::regeneratePlayer(Player* player) const
+void BedItem::regeneratePlayer(Player* player, uint32_t sleptTime)
 {
-	const uint32_t sleptTime = time(nullptr) - sleepStart;
-
 	Condition* condition = player->getCondition(CONDITION_REGENERATION, CONDITIONID_DEFAULT);
 	if (condition) {
 		uint32_t regen;
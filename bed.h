@@ -49,7 +49,7 @@ class BedItem final : public Item
 
 	private:
 		void updateAppearance(const Player* player);
-		void regeneratePlayer(Player* player) const;
+		static void regeneratePlayer(Player* player, uint32_t sleptTime);
 		void internalSetSleeper(const Player* player);
 		void internalRemoveSleeper();
 
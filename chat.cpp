@@ -37,8 +37,8 @@ void PrivateChatChannel::invitePlayer(const Player& player, Player& invitePlayer
 
 	player.sendTextMessage(MESSAGE_INFO_DESCR, fmt::format("{:s} has been invited.", invitePlayer.getName()));
 
-	for (const auto& it : users) {
-		it.second->sendChannelEvent(id, invitePlayer.getName(), CHANNELEVENT_INVITE);
+	for (Player* user : users) {
+		user->sendChannelEvent(id, invitePlayer.getName(), CHANNELEVENT_INVITE);
 	}
 }
 
@@ -54,21 +54,28 @@ void PrivateChatChannel::excludePlayer(const Player& player, Player& excludePlay
 
 	excludePlayer.sendClosePrivate(id);
 
-	for (const auto& it : users) {
-		it.second->sendChannelEvent(id, excludePlayer.getName(), CHANNELEVENT_EXCLUDE);
+	for (Player* user : users) {
+		user->sendChannelEvent(id, excludePlayer.getName(), CHANNELEVENT_EXCLUDE);
 	}
 }
 
 void PrivateChatChannel::closeChannel() const
 {
-	for (const auto& it : users) {
-		it.second->sendClosePrivate(id);
+	for (Player* user : users) {
+		user->sendClosePrivate(id);
 	}
 }
 
+UsersList::const_iterator ChatChannel::findUser(uint32_t playerId) const
+{
+	return std::lower_bound(users.begin(), users.end(), playerId, [](const Player* user, uint32_t playerId) {
+		return user->getID() < playerId;
+	});
+}
+
 bool ChatChannel::addUser(Player& player)
 {
-	if (users.find(player.getID()) != users.end()) {
+	if (hasUser(player)) {
 		return false;
 	}
 
@@ -85,27 +92,27 @@ bool ChatChannel::addUser(Player& player)
 	}
 
 	if (!publicChannel) {
-		for (const auto& it : users) {
-			it.second->sendChannelEvent(id, player.getName(), CHANNELEVENT_JOIN);
+		for (Player* user : users) {
+			user->sendChannelEvent(id, player.getName(), CHANNELEVENT_JOIN);
 		}
 	}
 
-	users[player.getID()] = &player;
+	users.insert(findUser(player.getID()), &player);
 	return true;
 }
 
 bool ChatChannel::removeUser(const Player& player)
 {
-	auto iter = users.find(player.getID());
-	if (iter == users.end()) {
+	auto iter = findUser(player.getID());
+	if (iter == users.end() || (*iter)->getID() != player.getID()) {
 		return false;
 	}
 
 	users.erase(iter);
 
 	if (!publicChannel) {
-		for (const auto& it : users) {
-			it.second->sendChannelEvent(id, player.getName(), CHANNELEVENT_LEAVE);
+		for (Player* user : users) {
+			user->sendChannelEvent(id, player.getName(), CHANNELEVENT_LEAVE);
 		}
 	}
 
@@ -114,24 +121,30 @@ bool ChatChannel::removeUser(const Player& player)
 }
 
 bool ChatChannel::hasUser(const Player& player) {
-	return users.find(player.getID()) != users.end();
+	auto iter = findUser(player.getID());
+	return iter != users.end() && (*iter)->getID() == player.getID();
 }
 
 void ChatChannel::sendToAll(const std::string& message, SpeakClasses type) const
 {
-	for (const auto& it : users) {
-		it.second->sendChannelMessage("", message, type, id);
+	// the message is the same for every member, encode it once
+	NetworkMessage msg;
+	ProtocolGame::AddChannelMessage(msg, "", message, type, id);
+	for (Player* user : users) {
+		user->sendNetworkMessage(msg);
 	}
 }
 
 bool ChatChannel::talk(const Player& fromPlayer, SpeakClasses type, const std::string& text)
 {
-	if (users.find(fromPlayer.getID()) == users.end()) {
+	if (!hasUser(fromPlayer)) {
 		return false;
 	}
 
-	for (const auto& it : users) {
-		it.second->sendToChannel(&fromPlayer, type, text, id);
+	NetworkMessage msg;
+	ProtocolGame::AddToChannel(msg, &fromPlayer, type, text, id);
+	for (Player* user : users) {
+		user->sendNetworkMessage(msg);
 	}
 	return true;
 }
@@ -297,9 +310,10 @@ bool Chat::load()
 				}
 			}
 
-			UsersMap tempUserMap = std::move(channel.users);
-			for (const auto& pair : tempUserMap) {
-				channel.addUser(*pair.second);
+			UsersList tempUsers;
+			tempUsers.swap(channel.users);
+			for (Player* user : tempUsers) {
+				channel.addUser(*user);
 			}
 			continue;
 		}
@@ -10,7 +10,8 @@
 class Party;
 class Player;
 
-using UsersMap = std::map<uint32_t, Player*>;
+// channel members sorted by player id, broadcasts walk them in order
+using UsersList = std::vector<Player*>;
 using InvitedMap = std::map<uint32_t, const Player*>;
 
 class ChatChannel
@@ -35,7 +36,7 @@ class ChatChannel
 		uint16_t getId() const {
 			return id;
 		}
-		const UsersMap& getUsers() const {
+		const UsersList& getUsers() const {
 			return users;
 		}
 		virtual const InvitedMap* getInvitedUsers() const {
@@ -54,7 +55,9 @@ class ChatChannel
 		bool executeOnSpeakEvent(const Player& player, SpeakClasses& type, const std::string& message);
 
 	protected:
-		UsersMap users;
+		UsersList::const_iterator findUser(uint32_t playerId) const;
+
+		UsersList users;
 
 		uint16_t id;
 
@@ -244,6 +244,7 @@ bool ConfigManager::load()
 	boolean[ONLY_INVITED_CAN_MOVE_HOUSE_ITEMS] = getGlobalBoolean(L, "onlyInvitedCanMoveHouseItems", true);
 	boolean[REMOVE_ON_DESPAWN] = getGlobalBoolean(L, "removeOnDespawn", true);
 	boolean[PLAYER_CONSOLE_LOGS] = getGlobalBoolean(L, "showPlayerLogInConsole", true);
+	boolean[MAP_SNAPSHOT] = getGlobalBoolean(L, "mapSnapshot", false);
 	boolean[WEATHER_RAIN] = getGlobalBoolean(L, "weatherRain", false);
 	boolean[WEATHER_THUNDER] = getGlobalBoolean(L, "thunderEffect", false);
 
@@ -292,6 +293,12 @@ bool ConfigManager::load()
 	integer[VIP_PREMIUM_LIMIT] = getGlobalNumber(L, "vipPremiumLimit", 100);
 	integer[DEPOT_FREE_LIMIT] = getGlobalNumber(L, "depotFreeLimit", 2000);
 	integer[DEPOT_PREMIUM_LIMIT] = getGlobalNumber(L, "depotPremiumLimit", 10000);
+	integer[MAX_LUA_COROUTINES] = getGlobalNumber(L, "maxLuaCoroutines", 20000);
+	integer[SCRIPTS_WATCH_INTERVAL] = getGlobalNumber(L, "scriptsWatchInterval", 0);
+	integer[LUA_GC_PAUSE] = getGlobalNumber(L, "luaGcPause", 200);
+	integer[LUA_GC_STEPMUL] = getGlobalNumber(L, "luaGcStepMul", 200);
+	integer[LUA_GC_IDLE_STEP_SIZE] = getGlobalNumber(L, "luaGcIdleStepSize", 0);
+	integer[MAX_QUEUED_SEND_BYTES] = getGlobalNumber(L, "maxQueuedSendBytes", 65536);
 
 	expStages = loadXMLStages();
 	if (expStages.empty()) {
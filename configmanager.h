@@ -54,6 +54,7 @@ class ConfigManager
 			ONLY_INVITED_CAN_MOVE_HOUSE_ITEMS,
 			REMOVE_ON_DESPAWN,
 			PLAYER_CONSOLE_LOGS,
+			MAP_SNAPSHOT,
 
 			LAST_BOOLEAN_CONFIG /* this must be the last one */
 		};
@@ -120,6 +121,12 @@ class ConfigManager
 			VIP_PREMIUM_LIMIT,
 			DEPOT_FREE_LIMIT,
 			DEPOT_PREMIUM_LIMIT,
+			MAX_LUA_COROUTINES,
+			SCRIPTS_WATCH_INTERVAL,
+			LUA_GC_PAUSE,
+			LUA_GC_STEPMUL,
+			LUA_GC_IDLE_STEP_SIZE,
+			MAX_QUEUED_SEND_BYTES,
 
 			LAST_INTEGER_CONFIG /* this must be the last one */
 		};
@@ -149,6 +149,7 @@ void Connection::parseHeader(const boost::system::error_code& error)
 		                                    std::placeholders::_1));
 
 		// Read packet content
+		msg.reserve(size + NetworkMessage::HEADER_LENGTH + NetworkMessage::INITIAL_BUFFER_POSITION);
 		msg.setLength(size + NetworkMessage::HEADER_LENGTH);
 		boost::asio::async_read(socket, boost::asio::buffer(msg.getBodyBuffer(), size),
 		                        std::bind(&Connection::parsePacket, shared_from_this(), std::placeholders::_1));
@@ -229,6 +230,7 @@ void Connection::send(const OutputMessage_ptr& msg)
 
 	bool noPendingWrite = messageQueue.empty();
 	messageQueue.emplace_back(msg);
+	queuedBytes += msg->getLength();
 	if (noPendingWrite) {
 		internalSend(msg);
 	}
@@ -236,6 +238,8 @@ void Connection::send(const OutputMessage_ptr& msg)
 
 void Connection::internalSend(const OutputMessage_ptr& msg)
 {
+	// the length grows by the headers and padding below, remember what send counted
+	writingBytes = msg->getLength();
 	protocol->onSendMessage(msg);
 	try {
 		writeTimer.expires_from_now(std::chrono::seconds(CONNECTION_WRITE_TIMEOUT));
@@ -270,9 +274,11 @@ void Connection::onWriteOperation(const boost::system::error_code& error)
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
 	writeTimer.cancel();
 	messageQueue.pop_front();
+	queuedBytes -= writingBytes;
 
 	if (error) {
 		messageQueue.clear();
+		queuedBytes = 0;
 		close(FORCE_CLOSE);
 		return;
 	}
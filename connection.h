@@ -72,6 +72,11 @@ class Connection : public std::enable_shared_from_this<Connection>
 
 		uint32_t getIP();
 
+		// bytes handed to the connection that are not written to the socket yet
+		uint32_t getQueuedBytes() const {
+			return queuedBytes;
+		}
+
 	private:
 		void parseHeader(const boost::system::error_code& error);
 		void parsePacket(const boost::system::error_code& error);
@@ -96,6 +101,8 @@ class Connection : public std::enable_shared_from_this<Connection>
 		std::recursive_mutex connectionLock;
 
 		std::list<OutputMessage_ptr> messageQueue;
+		std::atomic<uint32_t> queuedBytes {0};
+		uint32_t writingBytes = 0;
 
 		ConstServicePort_ptr service_port;
 		Protocol_ptr protocol;
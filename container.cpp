@@ -9,6 +9,34 @@
 
 extern Game g_game;
 
+namespace {
+
+// the player whose inventory index covers the items of this container, the
+// store inbox is held by the player without being part of the inventory
+Player* getIndexingPlayer(const Container* container)
+{
+	const Item* topItem = container;
+	Cylinder* parent = container->getParent();
+	while (parent) {
+		if (Creature* creature = parent->getCreature()) {
+			Player* player = creature->getPlayer();
+			if (player && topItem != player->getStoreInbox()) {
+				return player;
+			}
+			return nullptr;
+		}
+
+		topItem = parent->getItem();
+		if (!topItem) {
+			return nullptr;
+		}
+		parent = parent->getParent();
+	}
+	return nullptr;
+}
+
+}
+
 Container::Container(uint16_t type) :
 	Container(type, items[type].maxItems) {}
 
@@ -581,6 +609,10 @@ void Container::addThing(int32_t index, Thing* thing)
 	itemlist.push_front(item);
 	updateItemWeight(item->getWeight());
 
+	if (Player* player = getIndexingPlayer(this)) {
+		player->addToInventoryIndex(item);
+	}
+
 	//send change to client
 	if (getParent() && (getParent() != VirtualCylinder::virtualCylinder)) {
 		onAddContainerItem(item);
@@ -592,6 +624,10 @@ void Container::addItemBack(Item* item)
 	addItem(item);
 	updateItemWeight(item->getWeight());
 
+	if (Player* player = getIndexingPlayer(this)) {
+		player->addToInventoryIndex(item);
+	}
+
 	//send change to client
 	if (getParent() && (getParent() != VirtualCylinder::virtualCylinder)) {
 		onAddContainerItem(item);
@@ -610,11 +646,20 @@ void Container::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
 		return /*RETURNVALUE_NOTPOSSIBLE*/;
 	}
 
+	Player* player = getIndexingPlayer(this);
+	if (player) {
+		player->removeFromInventoryIndex(item, false);
+	}
+
 	const int32_t oldWeight = item->getWeight();
 	item->setID(itemId);
 	item->setSubType(count);
 	updateItemWeight(-oldWeight + item->getWeight());
 
+	if (player) {
+		player->addToInventoryIndex(item, false);
+	}
+
 	//send change to client
 	if (getParent()) {
 		onUpdateContainerItem(index, item, item);
@@ -637,6 +682,11 @@ void Container::replaceThing(uint32_t index, Thing* thing)
 	item->setParent(this);
 	updateItemWeight(-static_cast<int32_t>(replacedItem->getWeight()) + item->getWeight());
 
+	if (Player* player = getIndexingPlayer(this)) {
+		player->removeFromInventoryIndex(replacedItem);
+		player->addToInventoryIndex(item);
+	}
+
 	//send change to client
 	if (getParent()) {
 		onUpdateContainerItem(index, replacedItem, item);
@@ -657,12 +707,21 @@ void Container::removeThing(Thing* thing, uint32_t count)
 		return /*RETURNVALUE_NOTPOSSIBLE*/;
 	}
 
+	Player* player = getIndexingPlayer(this);
 	if (item->isStackable() && count != item->getItemCount()) {
 		uint8_t newCount = static_cast<uint8_t>(std::max<int32_t>(0, item->getItemCount() - count));
+		if (player) {
+			player->removeFromInventoryIndex(item, false);
+		}
+
 		const int32_t oldWeight = item->getWeight();
 		item->setItemCount(newCount);
 		updateItemWeight(-oldWeight + item->getWeight());
 
+		if (player) {
+			player->addToInventoryIndex(item, false);
+		}
+
 		//send change to client
 		if (getParent()) {
 			onUpdateContainerItem(index, item, item);
@@ -670,6 +729,10 @@ void Container::removeThing(Thing* thing, uint32_t count)
 	} else {
 		updateItemWeight(-static_cast<int32_t>(item->getWeight()));
 
+		if (player) {
+			player->removeFromInventoryIndex(item);
+		}
+
 		//send change to client
 		if (getParent()) {
 			onRemoveContainerItem(index, item);
@@ -786,6 +849,10 @@ void Container::internalAddThing(uint32_t, Thing* thing)
 	item->setParent(this);
 	itemlist.push_front(item);
 	updateItemWeight(item->getWeight());
+
+	if (Player* player = getIndexingPlayer(this)) {
+		player->addToInventoryIndex(item);
+	}
 }
 
 void Container::startDecaying()
@@ -510,6 +510,7 @@ class Creature : virtual public Thing
 		Creature* followCreature = nullptr;
 
 		uint64_t lastStep = 0;
+		uint64_t spectatorMark = 0; // see SpectatorVec::addSpectators
 		uint32_t referenceCounter = 0;
 		uint32_t id = 0;
 		uint32_t scriptEventsBitField = 0;
@@ -581,6 +582,7 @@ class Creature : virtual public Thing
 		friend class Game;
 		friend class Map;
 		friend class LuaScriptInterface;
+		friend class SpectatorVec;
 };
 
 #endif
@@ -24,6 +24,16 @@ void CreatureEvents::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void CreatureEvents::clearScriptFile(const std::string& scriptFile)
+{
+	// creatures keep pointers to their events, so they are only unloaded
+	for (auto& it : creatureEvents) {
+		if (it.second.fromLua && it.second.scriptFile == scriptFile) {
+			it.second.clearEvent();
+		}
+	}
+}
+
 void CreatureEvents::removeInvalidEvents()
 {
 	for (auto it = creatureEvents.begin(); it != creatureEvents.end(); ++it) {
@@ -97,6 +97,7 @@ class CreatureEvents final : public BaseEvents
 
 		bool registerLuaEvent(CreatureEvent* event);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 
 		void removeInvalidEvents();
 
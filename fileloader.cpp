@@ -3,7 +3,6 @@
 
 #include "otpch.h"
 
-#include <stack>
 #include "fileloader.h"
 
 namespace OTB {
@@ -25,52 +24,83 @@ Loader::Loader(const std::string& fileName, const Identifier& acceptedIdentifier
 	}
 }
 
-using NodeStack = std::stack<Node*, std::vector<Node*>>;
-static Node& getCurrentNode(const NodeStack& nodeStack) {
-	if (nodeStack.empty()) {
-		throw InvalidOTBFormat{};
-	}
-	return *nodeStack.top();
-}
+namespace {
 
-const Node& Loader::parseTree()
+struct ParseFrame
 {
-	auto it = fileContents.begin() + sizeof(Identifier);
-	if (static_cast<uint8_t>(*it) != Node::START) {
-		throw InvalidOTBFormat{};
-	}
-	root.type = *(++it);
-	root.propsBegin = ++it;
-	NodeStack parseStack;
-	parseStack.push(&root);
+	Node* node;
+	bool hasChildren;
+};
+
+// parses the node whose type byte is at it, returns past its end marker
+ContentIt parseNode(ContentIt it, ContentIt end, Node& node, size_t maxDepth)
+{
+	node.type = *it;
+	node.propsBegin = ++it;
 
-	for (; it != fileContents.end(); ++it) {
+	std::vector<ParseFrame> parseStack;
+	parseStack.push_back({&node, false});
+
+	// depth of the open nodes below maxDepth that are not kept
+	size_t skippedDepth = 0;
+
+	for (; it != end; ++it) {
 		switch(static_cast<uint8_t>(*it)) {
 			case Node::START: {
-				auto& currentNode = getCurrentNode(parseStack);
-				if (currentNode.children.empty()) {
-					currentNode.propsEnd = it;
+				if (++it == end) {
+					throw InvalidOTBFormat{};
 				}
-				currentNode.children.emplace_back();
-				auto& child = currentNode.children.back();
-				if (++it == fileContents.end()) {
+
+				if (skippedDepth != 0) {
+					++skippedDepth;
+					break;
+				}
+
+				if (parseStack.empty()) {
 					throw InvalidOTBFormat{};
 				}
+
+				auto& current = parseStack.back();
+				if (!current.hasChildren) {
+					current.node->propsEnd = it - 1;
+					current.hasChildren = true;
+				}
+
+				if (parseStack.size() > maxDepth) {
+					skippedDepth = 1;
+					break;
+				}
+
+				current.node->children.emplace_back();
+				auto& child = current.node->children.back();
 				child.type = *it;
 				child.propsBegin = it + sizeof(Node::type);
-				parseStack.push(&child);
+				parseStack.push_back({&child, false});
 				break;
 			}
 			case Node::END: {
-				auto& currentNode = getCurrentNode(parseStack);
-				if (currentNode.children.empty()) {
-					currentNode.propsEnd = it;
+				if (skippedDepth != 0) {
+					--skippedDepth;
+					break;
+				}
+
+				if (parseStack.empty()) {
+					throw InvalidOTBFormat{};
+				}
+
+				auto& current = parseStack.back();
+				if (!current.hasChildren) {
+					current.node->propsEnd = it;
+				}
+
+				parseStack.pop_back();
+				if (parseStack.empty()) {
+					return ++it;
 				}
-				parseStack.pop();
 				break;
 			}
 			case Node::ESCAPE: {
-				if (++it == fileContents.end()) {
+				if (++it == end) {
 					throw InvalidOTBFormat{};
 				}
 				break;
@@ -80,13 +110,44 @@ const Node& Loader::parseTree()
 			}
 		}
 	}
-	if (!parseStack.empty()) {
+	throw InvalidOTBFormat{};
+}
+
+}
+
+const Node& Loader::parseTree()
+{
+	return parseTree(std::numeric_limits<size_t>::max());
+}
+
+const Node& Loader::parseTree(size_t maxDepth)
+{
+	auto it = fileContents.begin() + sizeof(Identifier);
+	if (static_cast<uint8_t>(*it) != Node::START) {
 		throw InvalidOTBFormat{};
 	}
 
+	root = {};
+	parseNode(++it, fileContents.end(), root, maxDepth);
 	return root;
 }
 
+Node Loader::parseSubtree(size_t nodeOffset) const
+{
+	if (nodeOffset + sizeof(Node::START) + sizeof(Node::type) >= fileContents.size()) {
+		throw InvalidOTBFormat{};
+	}
+
+	auto it = fileContents.begin() + nodeOffset;
+	if (static_cast<uint8_t>(*it) != Node::START) {
+		throw InvalidOTBFormat{};
+	}
+
+	Node node;
+	parseNode(++it, fileContents.end(), node, std::numeric_limits<size_t>::max());
+	return node;
+}
+
 bool Loader::getProps(const Node& node, PropStream& props)
 {
 	auto size = std::distance(node.propsBegin, node.propsEnd);
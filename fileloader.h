@@ -49,6 +49,17 @@ public:
 	Loader(const std::string& fileName, const Identifier& acceptedIdentifier);
 	bool getProps(const Node& node, PropStream& props);
 	const Node& parseTree();
+
+	// Only keeps the nodes up to maxDepth levels below the root, deeper
+	// nodes are skipped and can be parsed later with parseSubtree, also by
+	// another Loader of the same file.
+	const Node& parseTree(size_t maxDepth);
+	Node parseSubtree(size_t nodeOffset) const;
+
+	// file offset of the node's start marker
+	size_t getNodeOffset(const Node& node) const {
+		return std::distance(fileContents.begin(), node.propsBegin) - sizeof(Node::START) - sizeof(Node::type);
+	}
 };
 
 } //namespace OTB
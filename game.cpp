@@ -14,6 +14,7 @@
 #include "events.h"
 #include "game.h"
 #include "globalevent.h"
+#include "iodelivery.h"
 #include "iologindata.h"
 #include "iomarket.h"
 #include "items.h"
@@ -42,6 +43,7 @@ extern Monsters g_monsters;
 extern MoveEvents* g_moveEvents;
 extern Weapons* g_weapons;
 extern Scripts* g_scripts;
+extern LuaEnvironment g_luaEnvironment;
 
 Game::Game()
 {
@@ -116,12 +118,6 @@ void Game::setGameState(GameState_t newState)
 			raids.loadFromXml();
 			raids.startup();
 
-			quests.loadFromXml();
-			mounts.loadFromXml();
-			auras.loadFromXml();
-			wings.loadFromXml();
-			shaders.loadFromXml();
-
 			loadMotdNum();
 			loadPlayersRecord();
 			loadAccountStorageValues();
@@ -1503,9 +1499,17 @@ bool Game::removeMoney(Cylinder* cylinder, uint64_t money, uint32_t flags /*= 0*
 		return true;
 	}
 
+	if (Creature* creature = cylinder->getCreature()) {
+		if (Player* player = creature->getPlayer()) {
+			if (player->getMoney() < money) {
+				return false;
+			}
+		}
+	}
+
 	std::vector<Container*> containers;
 
-	std::multimap<uint32_t, Item*> moneyMap;
+	std::vector<std::pair<uint32_t, Item*>> moneyMap;
 	uint64_t moneyCount = 0;
 
 	for (size_t i = cylinder->getFirstIndex(), j = cylinder->getLastIndex(); i < j; ++i) {
@@ -1526,7 +1530,7 @@ bool Game::removeMoney(Cylinder* cylinder, uint64_t money, uint32_t flags /*= 0*
 			const uint32_t worth = item->getWorth();
 			if (worth != 0) {
 				moneyCount += worth;
-				moneyMap.emplace(worth, item);
+				moneyMap.emplace_back(worth, item);
 			}
 		}
 	}
@@ -1542,7 +1546,7 @@ bool Game::removeMoney(Cylinder* cylinder, uint64_t money, uint32_t flags /*= 0*
 				const uint32_t worth = item->getWorth();
 				if (worth != 0) {
 					moneyCount += worth;
-					moneyMap.emplace(worth, item);
+					moneyMap.emplace_back(worth, item);
 				}
 			}
 		}
@@ -1552,6 +1556,10 @@ bool Game::removeMoney(Cylinder* cylinder, uint64_t money, uint32_t flags /*= 0*
 		return false;
 	}
 
+	std::stable_sort(moneyMap.begin(), moneyMap.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.first < rhs.first;
+	});
+
 	for (const auto& moneyEntry : moneyMap) {
 		Item* item = moneyEntry.second;
 		if (moneyEntry.first < money) {
@@ -2005,7 +2013,7 @@ void Game::playerOpenChannel(uint32_t playerId, uint16_t channelId)
 	}
 
 	const InvitedMap* invitedUsers = channel->getInvitedUsers();
-	const UsersMap* users;
+	const UsersList* users;
 	if (!channel->isPublicChannel()) {
 		users = &channel->getUsers();
 	} else {
@@ -3733,14 +3741,27 @@ bool Game::internalCreatureSay(Creature* creature, SpeakClasses type, const std:
 		spectators = (*spectatorsPtr);
 	}
 
-	//send to client
+	//send to client, the packet is the same for every spectator
+	//yells are heard beyond the screen, everything else only where it can be seen
+	const bool audibleOffScreen = type == TALKTYPE_YELL || type == TALKTYPE_MONSTER_YELL;
+	NetworkMessage msg;
+	ProtocolGame::AddCreatureSay(msg, creature, type, text, pos);
+	uint32_t sent = 0, suppressed = 0;
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			if (!ghostMode || tmpPlayer->canSeeCreature(creature)) {
-				tmpPlayer->sendCreatureSay(creature, type, text, pos);
+			if (ghostMode && !tmpPlayer->canSeeCreature(creature)) {
+				continue;
+			}
+
+			if (audibleOffScreen || tmpPlayer->canSee(*pos)) {
+				tmpPlayer->sendNetworkMessage(msg, ProtocolGame::getSpeechClass(type));
+				++sent;
+			} else {
+				++suppressed;
 			}
 		}
 	}
+	ProtocolGame::addBroadcastStats(BROADCAST_CREATURESAY, sent, suppressed, msg.getLength());
 
 	//event method
 	if (!echo) {
@@ -4509,9 +4530,11 @@ void Game::addCreatureHealth(const Creature* target)
 
 void Game::addCreatureHealth(const SpectatorVec& spectators, const Creature* target)
 {
+	NetworkMessage msg;
+	ProtocolGame::AddCreatureHealth(msg, target);
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendCreatureHealth(target);
+			tmpPlayer->sendNetworkMessage(msg);
 		}
 	}
 }
@@ -4525,11 +4548,20 @@ void Game::addMagicEffect(const Position& pos, uint16_t effect)
 
 void Game::addMagicEffect(const SpectatorVec& spectators, const Position& pos, uint16_t effect)
 {
+	NetworkMessage msg;
+	ProtocolGame::AddMagicEffect(msg, pos, effect);
+	uint32_t sent = 0, suppressed = 0;
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendMagicEffect(pos, effect);
+			if (tmpPlayer->canSee(pos)) {
+				tmpPlayer->sendNetworkMessage(msg, PACKET_COSMETIC);
+				++sent;
+			} else {
+				++suppressed;
+			}
 		}
 	}
+	ProtocolGame::addBroadcastStats(BROADCAST_MAGICEFFECT, sent, suppressed, msg.getLength());
 }
 
 void Game::addDistanceEffect(const Position& fromPos, const Position& toPos, uint8_t effect)
@@ -4544,11 +4576,21 @@ void Game::addDistanceEffect(const Position& fromPos, const Position& toPos, uin
 
 void Game::addDistanceEffect(const SpectatorVec& spectators, const Position& fromPos, const Position& toPos, uint8_t effect)
 {
+	NetworkMessage msg;
+	ProtocolGame::AddDistanceShoot(msg, fromPos, toPos, effect);
+	uint32_t sent = 0, suppressed = 0;
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendDistanceShoot(fromPos, toPos, effect);
+			// the missile is drawn while it crosses the screen, one end in view is enough
+			if (tmpPlayer->canSee(fromPos) || tmpPlayer->canSee(toPos)) {
+				tmpPlayer->sendNetworkMessage(msg, PACKET_COSMETIC);
+				++sent;
+			} else {
+				++suppressed;
+			}
 		}
 	}
+	ProtocolGame::addBroadcastStats(BROADCAST_DISTANCEEFFECT, sent, suppressed, msg.getLength());
 }
 
 void Game::setAccountStorageValue(const uint32_t accountId, const uint32_t key, const int32_t value)
@@ -5195,9 +5237,12 @@ void Game::playerBrowseMarketOwnHistory(uint32_t playerId)
 		return;
 	}
 
-	const HistoryMarketOfferList& buyOffers = IOMarket::getOwnHistory(MARKETACTION_BUY, player->getGUID());
-	const HistoryMarketOfferList& sellOffers = IOMarket::getOwnHistory(MARKETACTION_SELL, player->getGUID());
-	player->sendMarketBrowseOwnHistory(buyOffers, sellOffers);
+	IOMarket::getOwnHistory(player->getGUID(), [this, playerId](const HistoryMarketOfferList& buyOffers, const HistoryMarketOfferList& sellOffers) {
+		Player* player = getPlayerByID(playerId);
+		if (player && player->isInMarket()) {
+			player->sendMarketBrowseOwnHistory(buyOffers, sellOffers);
+		}
+	});
 }
 
 void Game::playerCreateMarketOffer(uint32_t playerId, uint8_t type, uint16_t spriteId, uint16_t amount, uint32_t price, bool anonymous)
@@ -5303,7 +5348,7 @@ void Game::playerCreateMarketOffer(uint32_t playerId, uint8_t type, uint16_t spr
 		player->bankBalance -= debitBank;
 	}
 
-	IOMarket::createOffer(player->getGUID(), static_cast<MarketAction_t>(type), it.id, amount, price, anonymous);
+	IOMarket::createOffer(player->getGUID(), player->getName(), static_cast<MarketAction_t>(type), it.id, amount, price, anonymous);
 
 	player->sendMarketEnter(player->getLastDepotId());
 	const MarketOfferList& buyOffers = IOMarket::getActiveOffers(MARKETACTION_BUY, it.id);
@@ -5420,15 +5465,6 @@ void Game::playerAcceptMarketOffer(uint32_t playerId, uint32_t timestamp, uint16
 			return;
 		}
 
-		Player* buyerPlayer = getPlayerByGUID(offer.playerId);
-		if (!buyerPlayer) {
-			buyerPlayer = new Player(nullptr);
-			if (!IOLoginData::loadPlayerById(buyerPlayer, offer.playerId)) {
-				delete buyerPlayer;
-				return;
-			}
-		}
-
 		if (it.stackable) {
 			uint16_t tmpAmount = amount;
 			for (Item* item : itemList) {
@@ -5448,41 +5484,7 @@ void Game::playerAcceptMarketOffer(uint32_t playerId, uint32_t timestamp, uint16
 
 		player->bankBalance += totalPrice;
 
-		if (it.stackable) {
-			uint16_t tmpAmount = amount;
-			while (tmpAmount > 0) {
-				uint16_t stackCount = std::min<uint16_t>(100, tmpAmount);
-				Item* item = Item::CreateItem(it.id, stackCount);
-				if (internalAddItem(buyerPlayer->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
-					delete item;
-					break;
-				}
-
-				tmpAmount -= stackCount;
-			}
-		} else {
-			int32_t subType;
-			if (it.charges != 0) {
-				subType = it.charges;
-			} else {
-				subType = -1;
-			}
-
-			for (uint16_t i = 0; i < amount; ++i) {
-				Item* item = Item::CreateItem(it.id, subType);
-				if (internalAddItem(buyerPlayer->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
-					delete item;
-					break;
-				}
-			}
-		}
-
-		if (buyerPlayer->isOffline()) {
-			IOLoginData::savePlayer(buyerPlayer);
-			delete buyerPlayer;
-		} else {
-			buyerPlayer->onReceiveMail();
-		}
+		IODelivery::deliverItems(offer.playerId, IOMarket::createOfferItems(it, amount));
 	} else {
 		if (totalPrice > (player->getMoney() + player->bankBalance)) {
 			return;
@@ -5522,12 +5524,7 @@ void Game::playerAcceptMarketOffer(uint32_t playerId, uint32_t timestamp, uint16
 			}
 		}
 
-		Player* sellerPlayer = getPlayerByGUID(offer.playerId);
-		if (sellerPlayer) {
-			sellerPlayer->bankBalance += totalPrice;
-		} else {
-			IOLoginData::increaseBankBalance(offer.playerId, totalPrice);
-		}
+		IODelivery::deliverBankBalance(offer.playerId, totalPrice);
 
 		player->onReceiveMail();
 	}
@@ -5814,7 +5811,13 @@ bool Game::reload(ReloadTypes_t reloadType)
 		case RELOAD_TYPE_ACTIONS: return g_actions->reload();
 		case RELOAD_TYPE_AURAS: return auras.reload();
 		case RELOAD_TYPE_CHAT: return g_chat->load();
-		case RELOAD_TYPE_CONFIG: return g_config.reload();
+		case RELOAD_TYPE_CONFIG: {
+			if (!g_config.reload()) {
+				return false;
+			}
+			g_luaEnvironment.setGarbageCollectorParameters();
+			return true;
+		}
 		case RELOAD_TYPE_CREATURESCRIPTS: {
 			g_creatureEvents->reload();
 			g_creatureEvents->removeInvalidEvents();
@@ -5822,7 +5825,11 @@ bool Game::reload(ReloadTypes_t reloadType)
 		}
 		case RELOAD_TYPE_EVENTS: return g_events->load();
 		case RELOAD_TYPE_GLOBALEVENTS: return g_globalEvents->reload();
-		case RELOAD_TYPE_ITEMS: return Item::items.reload();
+		case RELOAD_TYPE_ITEMS: {
+			// the cached tile descriptions hold the old client ids
+			Tile::clearItemsCaches();
+			return Item::items.reload();
+		}
 		case RELOAD_TYPE_MONSTERS: return g_monsters.reload();
 		case RELOAD_TYPE_MOUNTS: return mounts.reload();
 		case RELOAD_TYPE_MOVEMENTS: return g_moveEvents->reload();
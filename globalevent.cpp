@@ -47,6 +47,20 @@ void GlobalEvents::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void GlobalEvents::clearScriptFile(const std::string& scriptFile)
+{
+	// think and timer tasks keep running, they simply skip the removed events
+	for (GlobalEventMap* map : {&thinkMap, &serverMap, &timerMap}) {
+		for (auto it = map->begin(); it != map->end(); ) {
+			if (it->second.fromLua && it->second.scriptFile == scriptFile) {
+				it = map->erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
 Event_ptr GlobalEvents::getEvent(const std::string& nodeName)
 {
 	if (strcasecmp(nodeName.c_str(), "globalevent") != 0) {
@@ -158,6 +172,9 @@ void GlobalEvents::timer()
 	if (nextScheduledTime != std::numeric_limits<int64_t>::max()) {
 		timerEventId = g_scheduler.addEvent(createSchedulerTask(std::max<int64_t>(1000, nextScheduledTime * 1000),
 							                std::bind(&GlobalEvents::timer, this)));
+	} else {
+		// registerLuaEvent starts the loop again once an event is added
+		timerEventId = 0;
 	}
 }
 
@@ -191,6 +208,8 @@ void GlobalEvents::think()
 
 	if (nextScheduledTime != std::numeric_limits<int64_t>::max()) {
 		thinkEventId = g_scheduler.addEvent(createSchedulerTask(nextScheduledTime, std::bind(&GlobalEvents::think, this)));
+	} else {
+		thinkEventId = 0;
 	}
 }
 
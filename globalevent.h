@@ -41,6 +41,7 @@ class GlobalEvents final : public BaseEvents
 
 		bool registerLuaEvent(GlobalEvent* event);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 
 	private:
 		std::string getScriptBaseName() const override {
@@ -10,6 +10,8 @@
 #include "game.h"
 #include "configmanager.h"
 #include "bed.h"
+#include "databasetasks.h"
+#include "iodelivery.h"
 
 #include <fmt/format.h>
 
@@ -198,18 +200,13 @@ bool House::transferToDepot() const
 		return false;
 	}
 
-	Player* player = g_game.getPlayerByGUID(owner);
-	if (player) {
-		transferToDepot(player);
-	} else {
-		Player tmpPlayer(nullptr);
-		if (!IOLoginData::loadPlayerById(&tmpPlayer, owner)) {
-			return false;
-		}
-
-		transferToDepot(&tmpPlayer);
-		IOLoginData::savePlayer(&tmpPlayer);
+	// the items stay in the house when the owner no longer exists
+	if (!g_game.getPlayerByGUID(owner) && IOLoginData::getNameByGuid(owner).empty()) {
+		return false;
 	}
+
+	// an offline owner gets the items written to the inbox without being loaded
+	IODelivery::deliverItems(owner, getTransferableItems());
 	return true;
 }
 
@@ -219,6 +216,14 @@ bool House::transferToDepot(Player* player) const
 		return false;
 	}
 
+	for (Item* item : getTransferableItems()) {
+		g_game.internalMoveItem(item->getParent(), player->getInbox(), INDEX_WHEREEVER, item, item->getItemCount(), nullptr, FLAG_NOLIMIT);
+	}
+	return true;
+}
+
+ItemList House::getTransferableItems() const
+{
 	ItemList moveItemList;
 	for (HouseTile* tile : houseTiles) {
 		if (const TileItemVector* items = tile->getItemList()) {
@@ -236,11 +241,7 @@ bool House::transferToDepot(Player* player) const
 			}
 		}
 	}
-
-	for (Item* item : moveItemList) {
-		g_game.internalMoveItem(item->getParent(), player->getInbox(), INDEX_WHEREEVER, item, item->getItemCount(), nullptr, FLAG_NOLIMIT);
-	}
-	return true;
+	return moveItemList;
 }
 
 bool House::getAccessList(uint32_t listId, std::string& list) const
@@ -628,13 +629,83 @@ bool Houses::loadHousesXML(const std::string& filename)
 	return true;
 }
 
-void Houses::payHouses(RentPeriod_t rentPeriod) const
+namespace {
+
+time_t getRentPaidUntil(time_t currentTime, RentPeriod_t rentPeriod)
+{
+	switch (rentPeriod) {
+		case RENTPERIOD_DAILY:
+			return currentTime + 24 * 60 * 60;
+		case RENTPERIOD_WEEKLY:
+			return currentTime + 24 * 60 * 60 * 7;
+		case RENTPERIOD_MONTHLY:
+			return currentTime + 24 * 60 * 60 * 30;
+		case RENTPERIOD_YEARLY:
+			return currentTime + 24 * 60 * 60 * 365;
+		default:
+			return currentTime;
+	}
+}
+
+std::string getRentPeriodName(RentPeriod_t rentPeriod)
+{
+	switch (rentPeriod) {
+		case RENTPERIOD_DAILY:
+			return "daily";
+		case RENTPERIOD_WEEKLY:
+			return "weekly";
+		case RENTPERIOD_MONTHLY:
+			return "monthly";
+		case RENTPERIOD_YEARLY:
+			return "annual";
+		default:
+			return std::string();
+	}
+}
+
+std::string joinIds(const std::set<uint32_t>& ids)
+{
+	std::string joined;
+	for (uint32_t id : ids) {
+		if (!joined.empty()) {
+			joined.push_back(',');
+		}
+		joined.append(std::to_string(id));
+	}
+	return joined;
+}
+
+// sends a warning letter or takes the house away, returns true if the house was taken
+bool chargeUnpaidRent(House* house, uint32_t ownerId, RentPeriod_t rentPeriod)
+{
+	if (house->getPayRentWarnings() >= 7) {
+		house->setOwner(0);
+		return true;
+	}
+
+	int32_t daysLeft = 7 - house->getPayRentWarnings();
+
+	Item* letter = Item::CreateItem(ITEM_LETTER_STAMPED);
+	letter->setText(fmt::format("Warning! \nThe {:s} rent of {:d} gold for your house \"{:s}\" is payable. Have it within {:d} days or you will lose this house.", getRentPeriodName(rentPeriod), house->getRent(), house->getName(), daysLeft));
+	IODelivery::deliverItems(ownerId, {letter});
+	house->setPayRentWarnings(house->getPayRentWarnings() + 1);
+	return false;
+}
+
+}
+
+void Houses::payHouses(RentPeriod_t rentPeriod)
 {
 	if (rentPeriod == RENTPERIOD_NEVER) {
 		return;
 	}
 
-	time_t currentTime = time(nullptr);
+	RentCycle cycle;
+	cycle.rentPeriod = rentPeriod;
+	cycle.currentTime = time(nullptr);
+	cycle.startTime = OTSYS_TIME();
+
+	std::set<uint32_t> owners;
 	for (const auto& it : houseMap) {
 		House* house = it.second;
 		if (house->getOwner() == 0) {
@@ -642,81 +713,146 @@ void Houses::payHouses(RentPeriod_t rentPeriod) const
 		}
 
 		const uint32_t rent = house->getRent();
-		if (rent == 0 || house->getPaidUntil() > currentTime) {
+		if (rent == 0 || house->getPaidUntil() > cycle.currentTime) {
 			continue;
 		}
 
-		const uint32_t ownerId = house->getOwner();
-		Town* town = g_game.map.towns.getTown(house->getTownId());
-		if (!town) {
+		if (!g_game.map.towns.getTown(house->getTownId())) {
 			continue;
 		}
 
-		Player player(nullptr);
-		if (!IOLoginData::loadPlayerById(&player, ownerId)) {
-			// Player doesn't exist, reset house owner
-			house->setOwner(0);
-			continue;
-		}
+		cycle.dueHouses.emplace_back(house->getId(), house->getOwner());
+		owners.insert(house->getOwner());
+	}
 
-		if (player.getBankBalance() >= rent) {
-			player.setBankBalance(player.getBankBalance() - rent);
-
-			time_t paidUntil = currentTime;
-			switch (rentPeriod) {
-				case RENTPERIOD_DAILY:
-					paidUntil += 24 * 60 * 60;
-					break;
-				case RENTPERIOD_WEEKLY:
-					paidUntil += 24 * 60 * 60 * 7;
-					break;
-				case RENTPERIOD_MONTHLY:
-					paidUntil += 24 * 60 * 60 * 30;
-					break;
-				case RENTPERIOD_YEARLY:
-					paidUntil += 24 * 60 * 60 * 365;
-					break;
-				default:
-					break;
-			}
+	if (cycle.dueHouses.empty()) {
+		return;
+	}
 
-			house->setPaidUntil(paidUntil);
-		} else {
-			if (house->getPayRentWarnings() < 7) {
-				int32_t daysLeft = 7 - house->getPayRentWarnings();
+	// one query for the owners that still exist, the houses are charged once it returns
+	g_databaseTasks.addTask(fmt::format("SELECT `id` FROM `players` WHERE `id` IN ({:s})", joinIds(owners)),
+		[this, cycle = std::move(cycle)](DBResult_ptr result, bool) {
+			chargeRent(cycle, result);
+		}, true);
+}
 
-				Item* letter = Item::CreateItem(ITEM_LETTER_STAMPED);
-				std::string period;
+void Houses::chargeRent(const RentCycle& cycle, DBResult_ptr result)
+{
+	// owners that still exist, their balances are read again before charging
+	std::set<uint32_t> ownerIds;
+	if (result) {
+		do {
+			ownerIds.insert(result->getNumber<uint32_t>("id"));
+		} while (result->next());
+	}
 
-				switch (rentPeriod) {
-					case RENTPERIOD_DAILY:
-						period = "daily";
-						break;
+	uint32_t paid = 0, warned = 0, evicted = 0, ownerless = 0;
 
-					case RENTPERIOD_WEEKLY:
-						period = "weekly";
-						break;
+	// houses of offline owners, charged against the balances as they are now
+	std::vector<std::pair<House*, uint32_t>> offlineHouses;
+	std::set<uint32_t> offlineOwners;
 
-					case RENTPERIOD_MONTHLY:
-						period = "monthly";
-						break;
+	for (const auto& it : cycle.dueHouses) {
+		House* house = getHouse(it.first);
+		const uint32_t ownerId = it.second;
+		if (!house || house->getOwner() != ownerId || house->getPaidUntil() > cycle.currentTime) {
+			// changed hands or was paid while the balances were read
+			continue;
+		}
 
-					case RENTPERIOD_YEARLY:
-						period = "annual";
-						break;
+		const uint32_t rent = house->getRent();
+		if (Player* player = g_game.getPlayerByGUID(ownerId)) {
+			// logged in meanwhile, the balance in memory is the current one
+			if (player->getBankBalance() >= rent) {
+				player->setBankBalance(player->getBankBalance() - rent);
+				house->setPaidUntil(getRentPaidUntil(cycle.currentTime, cycle.rentPeriod));
+				++paid;
+			} else if (chargeUnpaidRent(house, ownerId, cycle.rentPeriod)) {
+				++evicted;
+			} else {
+				++warned;
+			}
+			continue;
+		}
 
-					default:
-						break;
+		if (ownerIds.find(ownerId) == ownerIds.end()) {
+			// Player doesn't exist, reset house owner
+			house->setOwner(0);
+			++ownerless;
+			continue;
+		}
+
+		offlineHouses.emplace_back(house, ownerId);
+		offlineOwners.insert(ownerId);
+	}
+
+	if (!offlineHouses.empty()) {
+		// the balances read before may be stale, they are read again with the rows
+		// locked until the charges are written. Runs on the dispatcher like player
+		// logins, so no owner can load the old balance in between.
+		Database& db = Database::getInstance();
+		std::vector<House*> paidHouses;
+		std::vector<std::pair<House*, uint32_t>> unpaidHouses;
+		bool charged = false;
+
+		DBTransaction transaction;
+		DBResult_ptr current;
+		if (transaction.begin() && (current = db.storeQuery(fmt::format("SELECT `id`, `balance` FROM `players` WHERE `id` IN ({:s}) FOR UPDATE", joinIds(offlineOwners))))) {
+			std::map<uint32_t, uint64_t> balances;
+			do {
+				balances[current->getNumber<uint32_t>("id")] = current->getNumber<uint64_t>("balance");
+			} while (current->next());
+
+			std::map<uint32_t, uint64_t> charges;
+			for (const auto& it : offlineHouses) {
+				const uint32_t rent = it.first->getRent();
+				auto balance = balances.find(it.second);
+				if (balance != balances.end() && balance->second >= rent) {
+					balance->second -= rent;
+					charges[it.second] += rent;
+					paidHouses.push_back(it.first);
+				} else {
+					unpaidHouses.push_back(it);
 				}
+			}
 
-				letter->setText(fmt::format("Warning! \nThe {:s} rent of {:d} gold for your house \"{:s}\" is payable. Have it within {:d} days or you will lose this house.", period, house->getRent(), house->getName(), daysLeft));
-				g_game.internalAddItem(player.getInbox(), letter, INDEX_WHEREEVER, FLAG_NOLIMIT);
-				house->setPayRentWarnings(house->getPayRentWarnings() + 1);
+			if (charges.empty()) {
+				charged = transaction.commit();
 			} else {
-				house->setOwner(0, true, &player);
+				// the rows are locked, the guard only keeps a balance from ever
+				// wrapping below zero
+				std::string cases, guards;
+				for (const auto& it : charges) {
+					cases.append(fmt::format(" WHEN {:d} THEN `balance` - {:d}", it.first, it.second));
+					if (!guards.empty()) {
+						guards.append(" OR ");
+					}
+					guards.append(fmt::format("(`id` = {:d} AND `balance` >= {:d})", it.first, it.second));
+				}
+
+				charged = db.executeQuery(fmt::format("UPDATE `players` SET `balance` = CASE `id`{:s} END WHERE {:s}", cases, guards)) && transaction.commit();
 			}
 		}
 
-		IOLoginData::savePlayer(&player);
+		if (!charged) {
+			// nothing was charged, the houses stay due and are charged by the next cycle
+			std::cout << "[Error - Houses::chargeRent] Failed to charge the rent of " << offlineHouses.size() << " houses of offline owners." << std::endl;
+		} else {
+			for (House* house : paidHouses) {
+				house->setPaidUntil(getRentPaidUntil(cycle.currentTime, cycle.rentPeriod));
+				++paid;
+			}
+
+			for (const auto& it : unpaidHouses) {
+				if (chargeUnpaidRent(it.first, it.second, cycle.rentPeriod)) {
+					// the house items and warning letters reach the inbox through the delivery queue
+					++evicted;
+				} else {
+					++warned;
+				}
+			}
+		}
 	}
+
+	std::cout << ">> House rent: " << paid << " paid, " << warned << " warned, " << evicted << " evicted, " << ownerless << " without owner (" << (OTSYS_TIME() - cycle.startTime) << " ms)" << std::endl;
 }
@@ -8,6 +8,7 @@
 #include <unordered_set>
 
 #include "container.h"
+#include "database.h"
 #include "housetile.h"
 #include "position.h"
 
@@ -210,6 +211,7 @@ class House
 	private:
 		bool transferToDepot() const;
 		bool transferToDepot(Player* player) const;
+		ItemList getTransferableItems() const;
 
 		AccessList guestList;
 		AccessList subOwnerList;
@@ -286,13 +288,23 @@ class Houses
 
 		bool loadHousesXML(const std::string& filename);
 
-		void payHouses(RentPeriod_t rentPeriod) const;
+		// charges the due rent in the background and prints a report once done
+		void payHouses(RentPeriod_t rentPeriod);
 
 		const HouseMap& getHouses() const {
 			return houseMap;
 		}
 
 	private:
+		struct RentCycle {
+			std::vector<std::pair<uint32_t, uint32_t>> dueHouses; // house id, owner id
+			RentPeriod_t rentPeriod;
+			time_t currentTime;
+			int64_t startTime;
+		};
+
+		void chargeRent(const RentCycle& cycle, DBResult_ptr result);
+
 		HouseMap houseMap;
 };
 
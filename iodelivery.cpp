@@ -0,0 +1,159 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "iodelivery.h"
+
+#include "databasetasks.h"
+#include "game.h"
+
+#include <fmt/format.h>
+
+extern Game g_game;
+
+void IODelivery::deliverItems(uint32_t playerId, const ItemList& items)
+{
+	if (items.empty()) {
+		return;
+	}
+
+	if (Player* player = g_game.getPlayerByGUID(playerId)) {
+		for (Item* item : items) {
+			if (Cylinder* parent = item->getParent()) {
+				g_game.internalMoveItem(parent, player->getInbox(), INDEX_WHEREEVER, item, item->getItemCount(), nullptr, FLAG_NOLIMIT);
+			} else if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
+				delete item;
+			}
+		}
+		player->onReceiveMail();
+		return;
+	}
+
+	// the rows are numbered from 1 and put after the highest sid the inbox has by the query,
+	// top level items keep pid 0 so they are loaded into the inbox itself
+	Database& db = Database::getInstance();
+	PropWriteStream propWriteStream;
+	std::list<std::pair<const Container*, int32_t>> queue;
+	std::string rows;
+	int32_t runningId = 0;
+
+	const auto addRow = [&](const Item* item, int32_t parentId) {
+		propWriteStream.clear();
+		item->serializeAttr(propWriteStream);
+
+		size_t attributesSize;
+		const char* attributes = propWriteStream.getStream(attributesSize);
+
+		if (rows.empty()) {
+			rows.append(fmt::format("SELECT {:d} AS `sid`, {:d} AS `pid`, {:d} AS `itemtype`, {:d} AS `count`, {:s} AS `attributes`", ++runningId, parentId, item->getID(), item->getSubType(), db.escapeBlob(attributes, attributesSize)));
+		} else {
+			rows.append(fmt::format(" UNION ALL SELECT {:d}, {:d}, {:d}, {:d}, {:s}", ++runningId, parentId, item->getID(), item->getSubType(), db.escapeBlob(attributes, attributesSize)));
+		}
+
+		if (const Container* container = item->getContainer()) {
+			queue.emplace_back(container, runningId);
+		}
+	};
+
+	for (const Item* item : items) {
+		addRow(item, 0);
+	}
+
+	while (!queue.empty()) {
+		const Container* container = queue.front().first;
+		int32_t parentId = queue.front().second;
+		queue.pop_front();
+
+		for (const Item* item : container->getItemList()) {
+			addRow(item, parentId);
+		}
+	}
+
+	std::string query = fmt::format("INSERT INTO `player_inboxitems` (`player_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) SELECT {:d}, IF(`items`.`pid` = 0, 0, `base`.`sid` + `items`.`pid`), `base`.`sid` + `items`.`sid`, `items`.`itemtype`, `items`.`count`, `items`.`attributes` FROM (SELECT COALESCE(MAX(`sid`), 100) AS `sid` FROM `player_inboxitems` WHERE `player_id` = {:d}) AS `base`, ({:s}) AS `items`", playerId, playerId, rows);
+
+	// the items leave the game now but are kept until the rows are written
+	for (Item* item : items) {
+		item->incrementReferenceCounter();
+		if (item->getParent()) {
+			g_game.internalRemoveItem(item);
+		}
+	}
+
+	getInstance().addPending(playerId);
+	g_databaseTasks.addTask(std::move(query), [playerId, items](DBResult_ptr, bool success) {
+		if (!success) {
+			// e.g. the player was deleted, the rows reference a player that does not exist
+			std::cout << "[Error - IODelivery::deliverItems] Could not deliver to player " << playerId << ", the following items are lost:" << std::endl;
+			for (const Item* item : items) {
+				std::cout << "\t" << item->getID() << " x" << item->getItemCount() << ' ' << item->getName();
+				if (const Container* container = item->getContainer()) {
+					std::cout << " holding " << container->getItemHoldingCount() << " items";
+				}
+				std::cout << std::endl;
+			}
+		}
+
+		for (Item* item : items) {
+			item->decrementReferenceCounter();
+		}
+		getInstance().removePending(playerId);
+	});
+}
+
+void IODelivery::deliverBankBalance(uint32_t playerId, uint64_t amount)
+{
+	if (amount == 0) {
+		return;
+	}
+
+	if (Player* player = g_game.getPlayerByGUID(playerId)) {
+		player->setBankBalance(player->getBankBalance() + amount);
+		return;
+	}
+
+	getInstance().addPending(playerId);
+	g_databaseTasks.addTask(fmt::format("UPDATE `players` SET `balance` = `balance` + {:d} WHERE `id` = {:d}", amount, playerId), [playerId, amount](DBResult_ptr, bool success) {
+		if (!success) {
+			std::cout << "[Error - IODelivery::deliverBankBalance] Could not deliver " << amount << " gold to player " << playerId << '.' << std::endl;
+		}
+		getInstance().removePending(playerId);
+	});
+}
+
+void IODelivery::whenDelivered(uint32_t playerId, std::function<void()> callback)
+{
+	IODelivery& delivery = getInstance();
+	if (delivery.pendingDeliveries.find(playerId) == delivery.pendingDeliveries.end()) {
+		callback();
+		return;
+	}
+
+	delivery.waitingCallbacks[playerId].push_back(std::move(callback));
+}
+
+void IODelivery::addPending(uint32_t playerId)
+{
+	++pendingDeliveries[playerId];
+}
+
+void IODelivery::removePending(uint32_t playerId)
+{
+	auto it = pendingDeliveries.find(playerId);
+	if (it == pendingDeliveries.end() || --it->second != 0) {
+		return;
+	}
+
+	pendingDeliveries.erase(it);
+
+	auto waiting = waitingCallbacks.find(playerId);
+	if (waiting == waitingCallbacks.end()) {
+		return;
+	}
+
+	std::vector<std::function<void()>> callbacks = std::move(waiting->second);
+	waitingCallbacks.erase(waiting);
+	for (const auto& callback : callbacks) {
+		callback();
+	}
+}
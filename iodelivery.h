@@ -0,0 +1,40 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#ifndef FS_IODELIVERY_H_3C6B2F0A8E5D4B7C9A1F6E2D8B4C0A57
+#define FS_IODELIVERY_H_3C6B2F0A8E5D4B7C9A1F6E2D8B4C0A57
+
+#include "item.h"
+
+// Items and gold sent to a player who may be offline. Online players get
+// them right away, for offline players the inbox rows and the bank balance
+// are written through the database task queue without loading the player.
+// Logins wait until the deliveries written for them are done, otherwise the
+// player could load the old inbox and save it over the delivered items.
+class IODelivery
+{
+	public:
+		static IODelivery& getInstance() {
+			static IODelivery instance;
+			return instance;
+		}
+
+		// items are either not placed yet or placed anywhere in the game,
+		// the delivery takes them over
+		static void deliverItems(uint32_t playerId, const ItemList& items);
+		static void deliverBankBalance(uint32_t playerId, uint64_t amount);
+
+		// runs the callback once every delivery written for the player is done
+		static void whenDelivered(uint32_t playerId, std::function<void()> callback);
+
+	private:
+		IODelivery() = default;
+
+		void addPending(uint32_t playerId);
+		void removePending(uint32_t playerId);
+
+		std::map<uint32_t, uint32_t> pendingDeliveries;
+		std::map<uint32_t, std::vector<std::function<void()>>> waitingCallbacks;
+};
+
+#endif
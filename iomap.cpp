@@ -8,6 +8,7 @@
 #include "bed.h"
 
 #include <fmt/format.h>
+#include <thread>
 
 /*
 	OTBM_ROOTV1
@@ -57,7 +58,8 @@ bool IOMap::loadMap(Map* map, const std::string& fileName)
 	int64_t start = OTSYS_TIME();
 	try {
 		OTB::Loader loader{fileName, OTB::Identifier{{'O', 'T', 'B', 'M'}}};
-		auto& root = loader.parseTree();
+		// root, map data and its children, tiles are decoded per tile area
+		auto& root = loader.parseTree(2);
 
 		PropStream propStream;
 		if (!loader.getProps(root, propStream)) {
@@ -118,24 +120,37 @@ bool IOMap::loadMap(Map* map, const std::string& fileName)
 			return false;
 		}
 
+		// tiles are not part of the scanned tree, tile areas are decoded by
+		// the worker threads and towns and waypoints parsed afterwards
+		std::vector<const OTB::Node*> tileAreaNodes;
+		std::vector<const OTB::Node*> mapDataNodes;
 		for (auto& mapDataNode : mapNode.children) {
 			if (mapDataNode.type == OTBM_TILE_AREA) {
-				if (!parseTileArea(loader, mapDataNode, *map)) {
-					return false;
-				}
-			} else if (mapDataNode.type == OTBM_TOWNS) {
-				if (!parseTowns(loader, mapDataNode, *map)) {
-					return false;
-				}
-			} else if (mapDataNode.type == OTBM_WAYPOINTS && headerVersion > 1) {
-				if (!parseWaypoints(loader, mapDataNode, *map)) {
-					return false;
-				}
+				tileAreaNodes.push_back(&mapDataNode);
+			} else if (mapDataNode.type == OTBM_TOWNS || (mapDataNode.type == OTBM_WAYPOINTS && headerVersion > 1)) {
+				mapDataNodes.push_back(&mapDataNode);
 			} else {
 				setLastErrorString("Unknown map node.");
 				return false;
 			}
 		}
+
+		std::cout << "> Map scan: " << tileAreaNodes.size() << " tile areas in " << (OTSYS_TIME() - start) / (1000.) << " seconds." << std::endl;
+
+		if (!loadTileAreas(fileName, loader, tileAreaNodes, *map)) {
+			return false;
+		}
+
+		for (const OTB::Node* mapDataNode : mapDataNodes) {
+			OTB::Node node = loader.parseSubtree(loader.getNodeOffset(*mapDataNode));
+			if (node.type == OTBM_TOWNS) {
+				if (!parseTowns(loader, node, *map)) {
+					return false;
+				}
+			} else if (!parseWaypoints(loader, node, *map)) {
+				return false;
+			}
+		}
 	} catch (const OTB::InvalidOTBFormat& err) {
 		setLastErrorString(err.what());
 		return false;
@@ -194,187 +209,451 @@ bool IOMap::parseMapDataAttributes(OTB::Loader& loader, const OTB::Node& mapNode
 	return true;
 }
 
-bool IOMap::parseTileArea(OTB::Loader& loader, const OTB::Node& tileAreaNode, Map& map)
+namespace {
+
+struct StagedTile
+{
+	std::vector<Item*> items; // ground and items in file order
+	std::vector<std::pair<Item*, uint16_t>> uniqueIds;
+	size_t nodeOffset = 0;
+	uint32_t flags = TILESTATE_NONE;
+	uint16_t x = 0;
+	uint16_t y = 0;
+	bool deferred = false;
+};
+
+struct StagedTileArea
+{
+	std::vector<StagedTile> tiles;
+	std::string error;
+	size_t nodeOffset = 0;
+	uint16_t baseX = 0;
+	uint16_t baseY = 0;
+	uint8_t z = 0;
+};
+
+uint32_t getTileState(uint32_t flags)
+{
+	uint32_t tileflags = TILESTATE_NONE;
+	if ((flags & OTBM_TILEFLAG_PROTECTIONZONE) != 0) {
+		tileflags |= TILESTATE_PROTECTIONZONE;
+	} else if ((flags & OTBM_TILEFLAG_NOPVPZONE) != 0) {
+		tileflags |= TILESTATE_NOPVPZONE;
+	} else if ((flags & OTBM_TILEFLAG_PVPZONE) != 0) {
+		tileflags |= TILESTATE_PVPZONE;
+	}
+
+	if ((flags & OTBM_TILEFLAG_NOLOGOUT) != 0) {
+		tileflags |= TILESTATE_NOLOGOUT;
+	}
+	return tileflags;
+}
+
+void deleteStagedItems(StagedTile& staged)
+{
+	for (Item* item : staged.items) {
+		delete item;
+	}
+	staged.items.clear();
+	staged.uniqueIds.clear();
+}
+
+// Decodes a tile without touching the map or the game state, tiles that need
+// them (houses and beds) are left to the main thread.
+bool stageTile(OTB::Loader& loader, const OTB::Node& tileNode, const StagedTileArea& area, StagedTile& staged, std::string& error)
+{
+	staged.nodeOffset = loader.getNodeOffset(tileNode);
+	if (tileNode.type == OTBM_HOUSETILE) {
+		staged.deferred = true;
+		return true;
+	}
+
+	PropStream propStream;
+	if (!loader.getProps(tileNode, propStream)) {
+		error = "Could not read node data.";
+		return false;
+	}
+
+	OTBM_Tile_coords tile_coord;
+	if (!propStream.read(tile_coord)) {
+		error = "Could not read tile position.";
+		return false;
+	}
+
+	uint16_t x = area.baseX + tile_coord.x;
+	uint16_t y = area.baseY + tile_coord.y;
+	uint16_t z = area.z;
+	staged.x = x;
+	staged.y = y;
+
+	uint8_t attribute;
+	//read tile attributes
+	while (propStream.read<uint8_t>(attribute)) {
+		switch (attribute) {
+			case OTBM_ATTR_TILE_FLAGS: {
+				uint32_t flags;
+				if (!propStream.read<uint32_t>(flags)) {
+					error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to read tile flags.", x, y, z);
+					return false;
+				}
+
+				staged.flags |= getTileState(flags);
+				break;
+			}
+
+			case OTBM_ATTR_ITEM: {
+				Item* item = Item::CreateItem(propStream);
+				if (!item) {
+					error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z);
+					return false;
+				}
+
+				staged.items.push_back(item);
+				if (item->getBed()) {
+					deleteStagedItems(staged);
+					staged.deferred = true;
+					return true;
+				}
+
+				if (item->getItemCount() == 0) {
+					item->setItemCount(1);
+				}
+				break;
+			}
+
+			default:
+				error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown tile attribute.", x, y, z);
+				return false;
+		}
+	}
+
+	for (auto& itemNode : tileNode.children) {
+		if (itemNode.type != OTBM_ITEM) {
+			error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown node type.", x, y, z);
+			return false;
+		}
+
+		PropStream stream;
+		if (!loader.getProps(itemNode, stream)) {
+			error = "Invalid item node.";
+			return false;
+		}
+
+		Item* item = Item::CreateItem(stream);
+		if (!item) {
+			error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z);
+			return false;
+		}
+
+		if (item->getBed()) {
+			// sleepers are resolved through the database
+			delete item;
+			deleteStagedItems(staged);
+			staged.deferred = true;
+			return true;
+		}
+
+		// unique ids are registered by the merge, in file order
+		Item::deferredUniqueIds = &staged.uniqueIds;
+		bool unserialized = item->unserializeItemNode(loader, itemNode, stream);
+		Item::deferredUniqueIds = nullptr;
+
+		if (!unserialized) {
+			error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to load item {:d}.", x, y, z, item->getID());
+			delete item;
+			return false;
+		}
+
+		if (item->getItemCount() == 0) {
+			item->setItemCount(1);
+		}
+		staged.items.push_back(item);
+	}
+	return true;
+}
+
+bool stageTileArea(OTB::Loader& loader, StagedTileArea& area)
 {
+	OTB::Node tileAreaNode = loader.parseSubtree(area.nodeOffset);
+
 	PropStream propStream;
 	if (!loader.getProps(tileAreaNode, propStream)) {
-		setLastErrorString("Invalid map node.");
+		area.error = "Invalid map node.";
 		return false;
 	}
 
 	OTBM_Destination_coords area_coord;
 	if (!propStream.read(area_coord)) {
-		setLastErrorString("Invalid map node.");
+		area.error = "Invalid map node.";
 		return false;
 	}
 
-	uint16_t base_x = area_coord.x;
-	uint16_t base_y = area_coord.y;
-	uint16_t z = area_coord.z;
+	area.baseX = area_coord.x;
+	area.baseY = area_coord.y;
+	area.z = area_coord.z;
 
-	for (auto& tileNode : tileAreaNode.children) {
+	area.tiles.resize(tileAreaNode.children.size());
+	for (size_t i = 0, size = tileAreaNode.children.size(); i < size; ++i) {
+		auto& tileNode = tileAreaNode.children[i];
 		if (tileNode.type != OTBM_TILE && tileNode.type != OTBM_HOUSETILE) {
-			setLastErrorString("Unknown tile node.");
+			area.error = "Unknown tile node.";
 			return false;
 		}
 
-		if (!loader.getProps(tileNode, propStream)) {
-			setLastErrorString("Could not read node data.");
+		if (!stageTile(loader, tileNode, area, area.tiles[i], area.error)) {
 			return false;
 		}
+	}
+	return true;
+}
 
-		OTBM_Tile_coords tile_coord;
-		if (!propStream.read(tile_coord)) {
-			setLastErrorString("Could not read tile position.");
-			return false;
-		}
+}
 
-		uint16_t x = base_x + tile_coord.x;
-		uint16_t y = base_y + tile_coord.y;
+void IOMap::addTileItem(Tile*& tile, Item*& ground, Item* item, uint16_t x, uint16_t y, uint8_t z)
+{
+	if (tile) {
+		tile->internalAddThing(item);
+		item->startDecaying();
+		item->setLoadedFromMap(true);
+	} else if (item->isGroundTile()) {
+		delete ground;
+		ground = item;
+	} else {
+		tile = createTile(ground, item, x, y, z);
+		tile->internalAddThing(item);
+		item->startDecaying();
+		item->setLoadedFromMap(true);
+	}
+}
 
-		bool isHouseTile = false;
-		House* house = nullptr;
-		Tile* tile = nullptr;
-		Item* ground_item = nullptr;
-		uint32_t tileflags = TILESTATE_NONE;
+bool IOMap::loadTileAreas(const std::string& fileName, OTB::Loader& loader, const std::vector<const OTB::Node*>& tileAreaNodes, Map& map)
+{
+	int64_t start = OTSYS_TIME();
 
-		if (tileNode.type == OTBM_HOUSETILE) {
-			uint32_t houseId;
-			if (!propStream.read<uint32_t>(houseId)) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not read house id.", x, y, z));
-				return false;
-			}
+	std::vector<StagedTileArea> areas(tileAreaNodes.size());
+	for (size_t i = 0, size = areas.size(); i < size; ++i) {
+		areas[i].nodeOffset = loader.getNodeOffset(*tileAreaNodes[i]);
+	}
 
-			house = map.houses.addHouse(houseId);
-			if (!house) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not create house id: {:d}", x, y, z, houseId));
-				return false;
+	std::atomic<size_t> nextArea{0};
+	std::atomic<bool> failed{false};
+	std::mutex errorLock;
+	std::string workerError;
+
+	// loaders are not thread-safe, every worker maps the file on its own
+	auto decodeAreas = [&]() {
+		try {
+			OTB::Loader areaLoader{fileName, OTB::Identifier{{'O', 'T', 'B', 'M'}}};
+			for (size_t i = nextArea++; i < areas.size() && !failed; i = nextArea++) {
+				if (!stageTileArea(areaLoader, areas[i])) {
+					failed = true;
+				}
 			}
-
-			tile = new HouseTile(x, y, z, house);
-			house->addTile(static_cast<HouseTile*>(tile));
-			isHouseTile = true;
+		} catch (const std::exception& err) {
+			std::lock_guard<std::mutex> lockGuard(errorLock);
+			workerError = err.what();
+			failed = true;
 		}
+	};
 
-		uint8_t attribute;
-		//read tile attributes
-		while (propStream.read<uint8_t>(attribute)) {
-			switch (attribute) {
-				case OTBM_ATTR_TILE_FLAGS: {
-					uint32_t flags;
-					if (!propStream.read<uint32_t>(flags)) {
-						setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to read tile flags.", x, y, z));
-						return false;
-					}
+	size_t threadCount = std::min<size_t>(std::max<uint32_t>(1, std::thread::hardware_concurrency()), areas.size());
 
-					if ((flags & OTBM_TILEFLAG_PROTECTIONZONE) != 0) {
-						tileflags |= TILESTATE_PROTECTIONZONE;
-					} else if ((flags & OTBM_TILEFLAG_NOPVPZONE) != 0) {
-						tileflags |= TILESTATE_NOPVPZONE;
-					} else if ((flags & OTBM_TILEFLAG_PVPZONE) != 0) {
-						tileflags |= TILESTATE_PVPZONE;
-					}
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		workers.emplace_back(decodeAreas);
+	}
 
-					if ((flags & OTBM_TILEFLAG_NOLOGOUT) != 0) {
-						tileflags |= TILESTATE_NOLOGOUT;
-					}
-					break;
-				}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
 
-				case OTBM_ATTR_ITEM: {
-					Item* item = Item::CreateItem(propStream);
-					if (!item) {
-						setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z));
-						return false;
-					}
+	auto discardAreas = [&areas]() {
+		for (StagedTileArea& area : areas) {
+			for (StagedTile& staged : area.tiles) {
+				deleteStagedItems(staged);
+			}
+		}
+	};
 
-					if (isHouseTile && item->isMoveable()) {
-						std::cout << "[Warning - IOMap::loadMap] Moveable item with ID: " << item->getID() << ", in house: " << house->getId() << ", at position [x: " << x << ", y: " << y << ", z: " << z << "]." << std::endl;
-						delete item;
-					} else {
-						if (item->getItemCount() == 0) {
-							item->setItemCount(1);
-						}
-
-						if (tile) {
-							tile->internalAddThing(item);
-							item->startDecaying();
-							item->setLoadedFromMap(true);
-						} else if (item->isGroundTile()) {
-							delete ground_item;
-							ground_item = item;
-						} else {
-							tile = createTile(ground_item, item, x, y, z);
-							tile->internalAddThing(item);
-							item->startDecaying();
-							item->setLoadedFromMap(true);
-						}
-					}
-					break;
-				}
+	if (failed) {
+		discardAreas();
+
+		auto it = std::find_if(areas.begin(), areas.end(), [](const StagedTileArea& area) { return !area.error.empty(); });
+		setLastErrorString(it != areas.end() ? it->error : workerError);
+		return false;
+	}
 
-				default:
-					setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown tile attribute.", x, y, z));
+	int64_t decodeEnd = OTSYS_TIME();
+
+	// merge in file order, same as loading the map from a single thread
+	for (StagedTileArea& area : areas) {
+		for (StagedTile& staged : area.tiles) {
+			if (staged.deferred) {
+				if (!parseTile(loader, loader.parseSubtree(staged.nodeOffset), area.baseX, area.baseY, area.z, map)) {
+					discardAreas();
 					return false;
+				}
+				continue;
 			}
-		}
 
-		for (auto& itemNode : tileNode.children) {
-			if (itemNode.type != OTBM_ITEM) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown node type.", x, y, z));
-				return false;
+			for (const auto& it : staged.uniqueIds) {
+				it.first->setUniqueId(it.second);
 			}
 
-			PropStream stream;
-			if (!loader.getProps(itemNode, stream)) {
-				setLastErrorString("Invalid item node.");
-				return false;
+			Tile* tile = nullptr;
+			Item* ground_item = nullptr;
+			for (Item* item : staged.items) {
+				addTileItem(tile, ground_item, item, staged.x, staged.y, area.z);
 			}
+			staged.items.clear();
 
-			Item* item = Item::CreateItem(stream);
-			if (!item) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z));
-				return false;
+			if (!tile) {
+				tile = createTile(ground_item, nullptr, staged.x, staged.y, area.z);
 			}
 
-			if (!item->unserializeItemNode(loader, itemNode, stream)) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to load item {:d}.", x, y, z, item->getID()));
-				delete item;
-				return false;
+			tile->setFlag(static_cast<tileflags_t>(staged.flags));
+
+			map.setTile(staged.x, staged.y, area.z, tile);
+		}
+		area.tiles.clear();
+		area.tiles.shrink_to_fit();
+	}
+
+	std::cout << "> Map decode: " << (decodeEnd - start) / (1000.) << " seconds (" << threadCount << " threads), merge: " << (OTSYS_TIME() - decodeEnd) / (1000.) << " seconds." << std::endl;
+	return true;
+}
+
+bool IOMap::parseTile(OTB::Loader& loader, const OTB::Node& tileNode, uint16_t baseX, uint16_t baseY, uint16_t z, Map& map)
+{
+	if (tileNode.type != OTBM_TILE && tileNode.type != OTBM_HOUSETILE) {
+		setLastErrorString("Unknown tile node.");
+		return false;
+	}
+
+	PropStream propStream;
+	if (!loader.getProps(tileNode, propStream)) {
+		setLastErrorString("Could not read node data.");
+		return false;
+	}
+
+	OTBM_Tile_coords tile_coord;
+	if (!propStream.read(tile_coord)) {
+		setLastErrorString("Could not read tile position.");
+		return false;
+	}
+
+	uint16_t x = baseX + tile_coord.x;
+	uint16_t y = baseY + tile_coord.y;
+
+	bool isHouseTile = false;
+	House* house = nullptr;
+	Tile* tile = nullptr;
+	Item* ground_item = nullptr;
+	uint32_t tileflags = TILESTATE_NONE;
+
+	if (tileNode.type == OTBM_HOUSETILE) {
+		uint32_t houseId;
+		if (!propStream.read<uint32_t>(houseId)) {
+			setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not read house id.", x, y, z));
+			return false;
+		}
+
+		house = map.houses.addHouse(houseId);
+		if (!house) {
+			setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not create house id: {:d}", x, y, z, houseId));
+			return false;
+		}
+
+		tile = new HouseTile(x, y, z, house);
+		house->addTile(static_cast<HouseTile*>(tile));
+		isHouseTile = true;
+	}
+
+	uint8_t attribute;
+	//read tile attributes
+	while (propStream.read<uint8_t>(attribute)) {
+		switch (attribute) {
+			case OTBM_ATTR_TILE_FLAGS: {
+				uint32_t flags;
+				if (!propStream.read<uint32_t>(flags)) {
+					setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to read tile flags.", x, y, z));
+					return false;
+				}
+
+				tileflags |= getTileState(flags);
+				break;
 			}
 
-			if (isHouseTile && item->isMoveable()) {
-				std::cout << "[Warning - IOMap::loadMap] Moveable item with ID: " << item->getID() << ", in house: " << house->getId() << ", at position [x: " << x << ", y: " << y << ", z: " << z << "]." << std::endl;
-				delete item;
-			} else {
-				if (item->getItemCount() == 0) {
-					item->setItemCount(1);
+			case OTBM_ATTR_ITEM: {
+				Item* item = Item::CreateItem(propStream);
+				if (!item) {
+					setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z));
+					return false;
 				}
 
-				if (tile) {
-					tile->internalAddThing(item);
-					item->startDecaying();
-					item->setLoadedFromMap(true);
-				} else if (item->isGroundTile()) {
-					delete ground_item;
-					ground_item = item;
+				if (isHouseTile && item->isMoveable()) {
+					std::cout << "[Warning - IOMap::loadMap] Moveable item with ID: " << item->getID() << ", in house: " << house->getId() << ", at position [x: " << x << ", y: " << y << ", z: " << z << "]." << std::endl;
+					delete item;
 				} else {
-					tile = createTile(ground_item, item, x, y, z);
-					tile->internalAddThing(item);
-					item->startDecaying();
-					item->setLoadedFromMap(true);
+					if (item->getItemCount() == 0) {
+						item->setItemCount(1);
+					}
+
+					addTileItem(tile, ground_item, item, x, y, z);
 				}
+				break;
 			}
+
+			default:
+				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown tile attribute.", x, y, z));
+				return false;
 		}
+	}
 
-		if (!tile) {
-			tile = createTile(ground_item, nullptr, x, y, z);
+	for (auto& itemNode : tileNode.children) {
+		if (itemNode.type != OTBM_ITEM) {
+			setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown node type.", x, y, z));
+			return false;
 		}
 
-		tile->setFlag(static_cast<tileflags_t>(tileflags));
+		PropStream stream;
+		if (!loader.getProps(itemNode, stream)) {
+			setLastErrorString("Invalid item node.");
+			return false;
+		}
 
-		map.setTile(x, y, z, tile);
+		Item* item = Item::CreateItem(stream);
+		if (!item) {
+			setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z));
+			return false;
+		}
+
+		if (!item->unserializeItemNode(loader, itemNode, stream)) {
+			setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to load item {:d}.", x, y, z, item->getID()));
+			delete item;
+			return false;
+		}
+
+		if (isHouseTile && item->isMoveable()) {
+			std::cout << "[Warning - IOMap::loadMap] Moveable item with ID: " << item->getID() << ", in house: " << house->getId() << ", at position [x: " << x << ", y: " << y << ", z: " << z << "]." << std::endl;
+			delete item;
+		} else {
+			if (item->getItemCount() == 0) {
+				item->setItemCount(1);
+			}
+
+			addTileItem(tile, ground_item, item, x, y, z);
+		}
+	}
+
+	if (!tile) {
+		tile = createTile(ground_item, nullptr, x, y, z);
 	}
+
+	tile->setFlag(static_cast<tileflags_t>(tileflags));
+
+	map.setTile(x, y, z, tile);
 	return true;
 }
 
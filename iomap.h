@@ -89,6 +89,7 @@ struct OTBM_Tile_coords {
 class IOMap
 {
 	static Tile* createTile(Item*& ground, Item* item, uint16_t x, uint16_t y, uint8_t z);
+	static void addTileItem(Tile*& tile, Item*& ground, Item* item, uint16_t x, uint16_t y, uint8_t z);
 
 	public:
 		bool loadMap(Map* map, const std::string& fileName);
@@ -135,7 +136,8 @@ class IOMap
 		bool parseMapDataAttributes(OTB::Loader& loader, const OTB::Node& mapNode, Map& map, const std::string& fileName);
 		bool parseWaypoints(OTB::Loader& loader, const OTB::Node& waypointsNode, Map& map);
 		bool parseTowns(OTB::Loader& loader, const OTB::Node& townsNode, Map& map);
-		bool parseTileArea(OTB::Loader& loader, const OTB::Node& tileAreaNode, Map& map);
+		bool parseTile(OTB::Loader& loader, const OTB::Node& tileNode, uint16_t baseX, uint16_t baseY, uint16_t z, Map& map);
+		bool loadTileAreas(const std::string& fileName, OTB::Loader& loader, const std::vector<const OTB::Node*>& tileAreaNodes, Map& map);
 		std::string errorString;
 };
 
@@ -0,0 +1,477 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "iomapsnapshot.h"
+#include "iomap.h"
+#include "depotlocker.h"
+
+#include <fstream>
+
+/*
+	header (SnapshotHeader)
+	width, height, spawn file, house file
+	towns: count, {id, name, temple position}
+	waypoints: count, {name, position}
+	tiles: count, {x, y, z, type, [house id], flags, item count, items}
+
+	item: id, attributes up to 0x00, [child count, children] for containers
+*/
+
+namespace {
+
+constexpr OTB::Identifier SNAPSHOT_IDENTIFIER = {{'O', 'T', 'M', 'S'}};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+constexpr auto ITEMS_OTB_FILE = "data/items/items.otb";
+constexpr auto ITEMS_XML_FILE = "data/items/items.xml";
+
+// flags read from the map, the others are derived from the tile's items
+constexpr uint32_t SNAPSHOT_TILE_FLAGS[] = {TILESTATE_PROTECTIONZONE, TILESTATE_NOPVPZONE, TILESTATE_PVPZONE, TILESTATE_NOLOGOUT};
+
+enum SnapshotTileType : uint8_t {
+	SNAPSHOT_TILE_STATIC,
+	SNAPSHOT_TILE_DYNAMIC,
+	SNAPSHOT_TILE_HOUSE,
+};
+
+#pragma pack(1)
+
+struct SnapshotHeader {
+	OTB::Identifier identifier;
+	uint32_t version;
+	uint64_t mapHash;
+	uint64_t itemsOtbHash;
+	uint64_t itemsXmlHash;
+	uint64_t dataHash; // everything after the header
+};
+
+#pragma pack()
+
+struct SnapshotTile {
+	std::vector<Item*> items; // ground first
+	std::vector<std::pair<Item*, uint16_t>> uniqueIds;
+	uint32_t houseId = 0;
+	uint32_t flags = TILESTATE_NONE;
+	uint16_t x = 0;
+	uint16_t y = 0;
+	uint8_t z = 0;
+	uint8_t type = SNAPSHOT_TILE_STATIC;
+};
+
+// FNV-1a
+uint64_t hashBytes(const char* data, size_t size)
+{
+	uint64_t hash = 0xCBF29CE484222325;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
+
+uint64_t hashFile(const std::string& fileName)
+{
+	try {
+		OTB::MappedFile file(fileName);
+		return hashBytes(file.data(), file.size());
+	} catch (const std::exception&) {
+		return 0;
+	}
+}
+
+SnapshotHeader getExpectedHeader(const std::string& fileName)
+{
+	SnapshotHeader header;
+	header.identifier = SNAPSHOT_IDENTIFIER;
+	header.version = SNAPSHOT_VERSION;
+	header.mapHash = hashFile(fileName);
+	header.itemsOtbHash = hashFile(ITEMS_OTB_FILE);
+	header.itemsXmlHash = hashFile(ITEMS_XML_FILE);
+	header.dataHash = 0;
+	return header;
+}
+
+void deleteTileItems(std::vector<SnapshotTile>& tiles)
+{
+	for (SnapshotTile& tile : tiles) {
+		for (Item* item : tile.items) {
+			delete item;
+		}
+	}
+	tiles.clear();
+}
+
+}
+
+bool IOMapSnapshot::load(Map& map, const std::string& fileName)
+{
+	int64_t start = OTSYS_TIME();
+
+	const std::string snapshotFileName = getSnapshotFileName(fileName);
+	if (!std::ifstream(snapshotFileName)) {
+		return false;
+	}
+
+	OTB::MappedFile file;
+	try {
+		file.open(snapshotFileName);
+	} catch (const std::exception& e) {
+		std::cout << "[Warning - IOMapSnapshot::load] Could not open " << snapshotFileName << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	PropStream propStream;
+	propStream.init(file.data(), file.size());
+
+	SnapshotHeader header;
+	if (!propStream.read(header) || header.identifier != SNAPSHOT_IDENTIFIER || header.version != SNAPSHOT_VERSION) {
+		std::cout << "> Map snapshot " << snapshotFileName << " has an unknown format, ignoring it." << std::endl;
+		return false;
+	}
+
+	SnapshotHeader expectedHeader = getExpectedHeader(fileName);
+	if (header.mapHash != expectedHeader.mapHash || header.itemsOtbHash != expectedHeader.itemsOtbHash || header.itemsXmlHash != expectedHeader.itemsXmlHash) {
+		std::cout << "> Map snapshot " << snapshotFileName << " is out of date, ignoring it." << std::endl;
+		return false;
+	}
+
+	if (hashBytes(file.data() + sizeof(header), file.size() - sizeof(header)) != header.dataHash) {
+		std::cout << "[Warning - IOMapSnapshot::load] Map snapshot " << snapshotFileName << " is corrupted, ignoring it." << std::endl;
+		return false;
+	}
+
+	// everything is read before the map is changed, so a bad snapshot can
+	// still fall back to the map file
+	uint16_t width, height;
+	std::string spawnfile, housefile;
+	std::vector<std::tuple<uint32_t, std::string, Position>> towns;
+	std::vector<std::pair<std::string, Position>> waypoints;
+	std::vector<SnapshotTile> tiles;
+
+	auto readSnapshot = [&]() {
+		if (!propStream.read<uint16_t>(width) || !propStream.read<uint16_t>(height) || !propStream.readString(spawnfile) || !propStream.readString(housefile)) {
+			return false;
+		}
+
+		uint32_t count;
+		if (!propStream.read<uint32_t>(count)) {
+			return false;
+		}
+
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t townId;
+			std::string townName;
+			OTBM_Destination_coords townCoords;
+			if (!propStream.read<uint32_t>(townId) || !propStream.readString(townName) || !propStream.read(townCoords)) {
+				return false;
+			}
+			towns.emplace_back(townId, std::move(townName), Position(townCoords.x, townCoords.y, townCoords.z));
+		}
+
+		if (!propStream.read<uint32_t>(count)) {
+			return false;
+		}
+
+		for (uint32_t i = 0; i < count; ++i) {
+			std::string name;
+			OTBM_Destination_coords waypointCoords;
+			if (!propStream.readString(name) || !propStream.read(waypointCoords)) {
+				return false;
+			}
+			waypoints.emplace_back(std::move(name), Position(waypointCoords.x, waypointCoords.y, waypointCoords.z));
+		}
+
+		if (!propStream.read<uint32_t>(count) || count > propStream.size()) {
+			return false;
+		}
+
+		tiles.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			tiles.emplace_back();
+			SnapshotTile& tile = tiles.back();
+
+			if (!propStream.read<uint16_t>(tile.x) || !propStream.read<uint16_t>(tile.y) || !propStream.read<uint8_t>(tile.z) || !propStream.read<uint8_t>(tile.type)) {
+				return false;
+			}
+
+			if (tile.z >= MAP_MAX_LAYERS || tile.type > SNAPSHOT_TILE_HOUSE) {
+				return false;
+			}
+
+			if (tile.type == SNAPSHOT_TILE_HOUSE && !propStream.read<uint32_t>(tile.houseId)) {
+				return false;
+			}
+
+			uint16_t itemCount;
+			if (!propStream.read<uint32_t>(tile.flags) || !propStream.read<uint16_t>(itemCount)) {
+				return false;
+			}
+
+			tile.items.reserve(itemCount);
+			for (uint16_t j = 0; j < itemCount; ++j) {
+				// unique ids are registered once the whole snapshot is read
+				Item::deferredUniqueIds = &tile.uniqueIds;
+				Item* item = loadItem(propStream);
+				Item::deferredUniqueIds = nullptr;
+
+				if (!item) {
+					return false;
+				}
+				tile.items.push_back(item);
+			}
+		}
+		return propStream.size() == 0;
+	};
+
+	if (!readSnapshot()) {
+		std::cout << "[Warning - IOMapSnapshot::load] Map snapshot " << snapshotFileName << " could not be read, ignoring it." << std::endl;
+		deleteTileItems(tiles);
+		return false;
+	}
+
+	std::cout << "> Map size: " << width << "x" << height << '.' << std::endl;
+	map.width = width;
+	map.height = height;
+	map.spawnfile = spawnfile;
+	map.housefile = housefile;
+
+	for (SnapshotTile& snapshotTile : tiles) {
+		for (const auto& it : snapshotTile.uniqueIds) {
+			it.first->setUniqueId(it.second);
+		}
+
+		Tile* tile;
+		if (snapshotTile.type == SNAPSHOT_TILE_HOUSE) {
+			House* house = map.houses.addHouse(snapshotTile.houseId);
+			tile = new HouseTile(snapshotTile.x, snapshotTile.y, snapshotTile.z, house);
+			house->addTile(static_cast<HouseTile*>(tile));
+		} else if (snapshotTile.type == SNAPSHOT_TILE_DYNAMIC) {
+			tile = new DynamicTile(snapshotTile.x, snapshotTile.y, snapshotTile.z);
+		} else {
+			tile = new StaticTile(snapshotTile.x, snapshotTile.y, snapshotTile.z);
+		}
+
+		for (Item* item : snapshotTile.items) {
+			tile->internalAddThing(item);
+			item->startDecaying();
+			if (item != tile->getGround()) {
+				item->setLoadedFromMap(true);
+			}
+		}
+
+		tile->setFlag(snapshotTile.flags);
+		map.setTile(snapshotTile.x, snapshotTile.y, snapshotTile.z, tile);
+	}
+
+	for (auto& it : towns) {
+		uint32_t townId = std::get<0>(it);
+		Town* town = map.towns.getTown(townId);
+		if (!town) {
+			town = new Town(townId);
+			map.towns.addTown(townId, town);
+		}
+
+		town->setName(std::get<1>(it));
+		town->setTemplePos(std::get<2>(it));
+	}
+
+	for (auto& it : waypoints) {
+		map.waypoints[it.first] = it.second;
+	}
+
+	std::cout << "> Map loaded from snapshot " << snapshotFileName << " in " << (OTSYS_TIME() - start) / (1000.) << " seconds." << std::endl;
+	return true;
+}
+
+bool IOMapSnapshot::save(const Map& map, const std::string& fileName)
+{
+	int64_t start = OTSYS_TIME();
+
+	PropWriteStream stream;
+	stream.write<uint16_t>(map.width);
+	stream.write<uint16_t>(map.height);
+	stream.writeString(map.spawnfile);
+	stream.writeString(map.housefile);
+
+	const auto& towns = map.towns.getTowns();
+	stream.write<uint32_t>(towns.size());
+	for (const auto& it : towns) {
+		const Town* town = it.second;
+		const Position& templePos = town->getTemplePosition();
+		stream.write<uint32_t>(town->getID());
+		stream.writeString(town->getName());
+		stream.write(OTBM_Destination_coords{templePos.x, templePos.y, templePos.z});
+	}
+
+	stream.write<uint32_t>(map.waypoints.size());
+	for (const auto& it : map.waypoints) {
+		stream.writeString(it.first);
+		stream.write(OTBM_Destination_coords{it.second.x, it.second.y, it.second.z});
+	}
+
+	std::vector<const Tile*> tiles;
+	map.forEachTile([&tiles](const Tile* tile) { tiles.push_back(tile); });
+
+	stream.write<uint32_t>(tiles.size());
+	for (const Tile* tile : tiles) {
+		saveTile(stream, tile);
+	}
+
+	size_t size;
+	const char* data = stream.getStream(size);
+
+	SnapshotHeader header = getExpectedHeader(fileName);
+	header.dataHash = hashBytes(data, size);
+
+	// written next to the snapshot and renamed, a crash never leaves a
+	// partial snapshot behind
+	const std::string snapshotFileName = getSnapshotFileName(fileName);
+	const std::string tempFileName = snapshotFileName + ".tmp";
+	{
+		std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cout << "[Error - IOMapSnapshot::save] Could not open " << tempFileName << " for writing." << std::endl;
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data, size);
+		if (!file) {
+			std::cout << "[Error - IOMapSnapshot::save] Could not write " << tempFileName << '.' << std::endl;
+			return false;
+		}
+	}
+
+	if (std::rename(tempFileName.c_str(), snapshotFileName.c_str()) != 0) {
+		std::cout << "[Error - IOMapSnapshot::save] Could not rename " << tempFileName << " to " << snapshotFileName << '.' << std::endl;
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+	std::cout << "> Map snapshot " << snapshotFileName << " saved in " << (OTSYS_TIME() - start) / (1000.) << " seconds." << std::endl;
+	return true;
+}
+
+void IOMapSnapshot::saveTile(PropWriteStream& stream, const Tile* tile)
+{
+	const Position& position = tile->getPosition();
+	stream.write<uint16_t>(position.x);
+	stream.write<uint16_t>(position.y);
+	stream.write<uint8_t>(position.z);
+
+	if (const HouseTile* houseTile = dynamic_cast<const HouseTile*>(tile)) {
+		stream.write<uint8_t>(SNAPSHOT_TILE_HOUSE);
+		stream.write<uint32_t>(houseTile->getHouse()->getId());
+	} else if (dynamic_cast<const DynamicTile*>(tile)) {
+		stream.write<uint8_t>(SNAPSHOT_TILE_DYNAMIC);
+	} else {
+		stream.write<uint8_t>(SNAPSHOT_TILE_STATIC);
+	}
+
+	uint32_t flags = TILESTATE_NONE;
+	for (uint32_t flag : SNAPSHOT_TILE_FLAGS) {
+		if (tile->hasFlag(flag)) {
+			flags |= flag;
+		}
+	}
+	stream.write<uint32_t>(flags);
+
+	// items are written in the order that rebuilds the same tile through
+	// internalAddThing, which puts every new down item first
+	std::vector<const Item*> items;
+	if (const Item* ground = tile->getGround()) {
+		items.push_back(ground);
+	}
+
+	if (const TileItemVector* tileItems = tile->getItemList()) {
+		items.insert(items.end(), tileItems->getBeginTopItem(), tileItems->getEndTopItem());
+		for (auto it = tileItems->getEndDownItem(), begin = tileItems->getBeginDownItem(); it != begin;) {
+			items.push_back(*--it);
+		}
+	}
+
+	stream.write<uint16_t>(items.size());
+	for (const Item* item : items) {
+		saveItem(stream, item);
+	}
+}
+
+void IOMapSnapshot::saveItem(PropWriteStream& stream, const Item* item)
+{
+	stream.write<uint16_t>(item->getID());
+
+	// attributes the database serialization leaves out since they come from
+	// the map file
+	if (const Door* door = item->getDoor()) {
+		door->Item::serializeAttr(stream);
+		if (door->getDoorId() != 0) {
+			stream.write<uint8_t>(ATTR_HOUSEDOORID);
+			stream.write<uint8_t>(door->getDoorId());
+		}
+	} else {
+		item->serializeAttr(stream);
+	}
+
+	if (item->hasAttribute(ITEM_ATTRIBUTE_UNIQUEID)) {
+		stream.write<uint8_t>(ATTR_UNIQUE_ID);
+		stream.write<uint16_t>(item->getUniqueId());
+	}
+
+	const DepotLocker* depotLocker = dynamic_cast<const DepotLocker*>(item);
+	if (depotLocker) {
+		stream.write<uint8_t>(ATTR_DEPOT_ID);
+		stream.write<uint16_t>(depotLocker->getDepotId());
+	}
+
+	stream.write<uint8_t>(0x00); // attr end
+
+	// depot lockers are filled by the players' depots
+	const Container* container = item->getContainer();
+	if (container && !depotLocker) {
+		stream.write<uint32_t>(container->size());
+		for (auto it = container->getReversedItems(), end = container->getReversedEnd(); it != end; ++it) {
+			saveItem(stream, *it);
+		}
+	}
+}
+
+Item* IOMapSnapshot::loadItem(PropStream& propStream)
+{
+	uint16_t id;
+	if (!propStream.read<uint16_t>(id)) {
+		return nullptr;
+	}
+
+	Item* item = Item::CreateItem(id);
+	if (!item) {
+		return nullptr;
+	}
+
+	if (!item->unserializeAttr(propStream)) {
+		delete item;
+		return nullptr;
+	}
+
+	Container* container = item->getContainer();
+	if (!container || dynamic_cast<DepotLocker*>(item)) {
+		return item;
+	}
+
+	uint32_t count;
+	if (!propStream.read<uint32_t>(count)) {
+		delete item;
+		return nullptr;
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		Item* child = loadItem(propStream);
+		if (!child) {
+			delete item;
+			return nullptr;
+		}
+		container->internalAddThing(child);
+	}
+	return item;
+}
@@ -0,0 +1,31 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#ifndef FS_IOMAPSNAPSHOT_H_2B533DDBB02D440E8960DBAE601D9FD8
+#define FS_IOMAPSNAPSHOT_H_2B533DDBB02D440E8960DBAE601D9FD8
+
+#include "map.h"
+
+// Compiled copy of a loaded map: tiles, their items, house tile membership,
+// towns and waypoints in a flat layout without escaping or a node tree. It
+// is only used while the map file, items.otb and items.xml it was written
+// from are unchanged.
+class IOMapSnapshot
+{
+	public:
+		// loads the map from the snapshot of fileName, returns false without
+		// touching the map when there is no valid snapshot
+		static bool load(Map& map, const std::string& fileName);
+		static bool save(const Map& map, const std::string& fileName);
+
+	private:
+		static std::string getSnapshotFileName(const std::string& fileName) {
+			return fileName + ".snapshot";
+		}
+
+		static void saveTile(PropWriteStream& stream, const Tile* tile);
+		static void saveItem(PropWriteStream& stream, const Item* item);
+		static Item* loadItem(PropStream& propStream);
+};
+
+#endif
@@ -7,7 +7,7 @@
 
 #include "configmanager.h"
 #include "databasetasks.h"
-#include "iologindata.h"
+#include "iodelivery.h"
 #include "game.h"
 #include "scheduler.h"
 
@@ -16,163 +16,209 @@
 extern ConfigManager g_config;
 extern Game g_game;
 
-MarketOfferList IOMarket::getActiveOffers(MarketAction_t action, uint16_t itemId)
+void IOMarket::loadOffers()
 {
-	MarketOfferList offerList;
+	offers.clear();
+	book.clear();
+	playerOffers.clear();
+	expiry.clear();
 
-	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `id`, `amount`, `price`, `created`, `anonymous`, (SELECT `name` FROM `players` WHERE `id` = `player_id`) AS `player_name` FROM `market_offers` WHERE `sale` = {:d} AND `itemtype` = {:d}", action, itemId));
+	DBResult_ptr result = Database::getInstance().storeQuery("SELECT `market_offers`.`id`, `player_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`, `players`.`name` AS `player_name` FROM `market_offers` LEFT JOIN `players` ON `players`.`id` = `market_offers`.`player_id`");
 	if (!result) {
-		return offerList;
+		return;
 	}
 
-	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
-
 	do {
-		MarketOffer offer;
+		Offer offer;
+		offer.id = result->getNumber<uint32_t>("id");
+		offer.playerId = result->getNumber<uint32_t>("player_id");
+		offer.type = static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale"));
+		offer.itemId = result->getNumber<uint16_t>("itemtype");
 		offer.amount = result->getNumber<uint16_t>("amount");
 		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("created") + marketOfferDuration;
-		offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-		if (result->getNumber<uint16_t>("anonymous") == 0) {
-			offer.playerName = result->getString("player_name");
-		} else {
-			offer.playerName = "Anonymous";
-		}
-		offerList.push_back(offer);
+		offer.created = result->getNumber<uint32_t>("created");
+		offer.anonymous = result->getNumber<uint16_t>("anonymous") != 0;
+		offer.playerName = result->getString("player_name");
+		addOffer(std::move(offer));
 	} while (result->next());
-	return offerList;
 }
 
-MarketOfferList IOMarket::getOwnOffers(MarketAction_t action, uint32_t playerId)
+void IOMarket::addOffer(Offer&& offer)
 {
-	MarketOfferList offerList;
+	const uint32_t id = offer.id;
+	nextOfferId = std::max(nextOfferId, id + 1);
+
+	book[{offer.itemId, offer.type}].emplace(offer.price, id);
+	playerOffers[offer.playerId].insert(id);
+	expiry.emplace(offer.created, id);
+	offers.emplace(id, std::move(offer));
+}
 
-	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+void IOMarket::removeOffer(std::map<uint32_t, Offer>::iterator it)
+{
+	const Offer& offer = it->second;
 
-	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `id`, `amount`, `price`, `created`, `itemtype` FROM `market_offers` WHERE `player_id` = {:d} AND `sale` = {:d}", playerId, action));
-	if (!result) {
-		return offerList;
+	auto bookIt = book.find({offer.itemId, offer.type});
+	if (bookIt != book.end()) {
+		bookIt->second.erase({offer.price, offer.id});
+		if (bookIt->second.empty()) {
+			book.erase(bookIt);
+		}
 	}
 
-	do {
-		MarketOffer offer;
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("created") + marketOfferDuration;
-		offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-		offer.itemId = result->getNumber<uint16_t>("itemtype");
-		offerList.push_back(offer);
-	} while (result->next());
-	return offerList;
+	auto playerIt = playerOffers.find(offer.playerId);
+	if (playerIt != playerOffers.end()) {
+		playerIt->second.erase(offer.id);
+		if (playerIt->second.empty()) {
+			playerOffers.erase(playerIt);
+		}
+	}
+
+	expiry.erase({offer.created, offer.id});
+	offers.erase(it);
 }
 
-HistoryMarketOfferList IOMarket::getOwnHistory(MarketAction_t action, uint32_t playerId)
+MarketOffer IOMarket::toMarketOffer(const Offer& offer)
 {
-	HistoryMarketOfferList offerList;
+	MarketOffer marketOffer;
+	marketOffer.amount = offer.amount;
+	marketOffer.price = offer.price;
+	marketOffer.timestamp = offer.created + g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+	marketOffer.counter = offer.id & 0xFFFF;
+	marketOffer.itemId = offer.itemId;
+	return marketOffer;
+}
 
-	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `itemtype`, `amount`, `price`, `expires_at`, `state` FROM `market_history` WHERE `player_id` = {:d} AND `sale` = {:d}", playerId, action));
-	if (!result) {
+MarketOfferList IOMarket::getActiveOffers(MarketAction_t action, uint16_t itemId)
+{
+	IOMarket& market = getInstance();
+
+	MarketOfferList offerList;
+
+	auto bookIt = market.book.find({itemId, action});
+	if (bookIt == market.book.end()) {
 		return offerList;
 	}
 
-	do {
-		HistoryMarketOffer offer;
-		offer.itemId = result->getNumber<uint16_t>("itemtype");
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("expires_at");
+	for (const PriceKey& key : bookIt->second) {
+		const Offer& offer = market.offers[key.second];
 
-		MarketOfferState_t offerState = static_cast<MarketOfferState_t>(result->getNumber<uint16_t>("state"));
-		if (offerState == OFFERSTATE_ACCEPTEDEX) {
-			offerState = OFFERSTATE_ACCEPTED;
+		MarketOffer marketOffer = toMarketOffer(offer);
+		if (!offer.anonymous) {
+			marketOffer.playerName = offer.playerName;
+		} else {
+			marketOffer.playerName = "Anonymous";
 		}
-
-		offer.state = offerState;
-
-		offerList.push_back(offer);
-	} while (result->next());
+		offerList.push_back(std::move(marketOffer));
+	}
 	return offerList;
 }
 
-void IOMarket::processExpiredOffers(DBResult_ptr result, bool)
+MarketOfferList IOMarket::getOwnOffers(MarketAction_t action, uint32_t playerId)
 {
-	if (!result) {
-		return;
+	IOMarket& market = getInstance();
+
+	MarketOfferList offerList;
+
+	auto playerIt = market.playerOffers.find(playerId);
+	if (playerIt == market.playerOffers.end()) {
+		return offerList;
 	}
 
-	do {
-		if (!IOMarket::moveOfferToHistory(result->getNumber<uint32_t>("id"), OFFERSTATE_EXPIRED)) {
-			continue;
+	for (uint32_t offerId : playerIt->second) {
+		const Offer& offer = market.offers[offerId];
+		if (offer.type == action) {
+			offerList.push_back(toMarketOffer(offer));
 		}
+	}
+	return offerList;
+}
 
-		const uint32_t playerId = result->getNumber<uint32_t>("player_id");
-		const uint16_t amount = result->getNumber<uint16_t>("amount");
-		if (result->getNumber<uint16_t>("sale") == 1) {
-			const ItemType& itemType = Item::items[result->getNumber<uint16_t>("itemtype")];
-			if (itemType.id == 0) {
-				continue;
-			}
-
-			Player* player = g_game.getPlayerByGUID(playerId);
-			if (!player) {
-				player = new Player(nullptr);
-				if (!IOLoginData::loadPlayerById(player, playerId)) {
-					delete player;
-					continue;
-				}
-			}
-
-			if (itemType.stackable) {
-				uint16_t tmpAmount = amount;
-				while (tmpAmount > 0) {
-					uint16_t stackCount = std::min<uint16_t>(100, tmpAmount);
-					Item* item = Item::CreateItem(itemType.id, stackCount);
-					if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
-						delete item;
-						break;
-					}
-
-					tmpAmount -= stackCount;
-				}
-			} else {
-				int32_t subType;
-				if (itemType.charges != 0) {
-					subType = itemType.charges;
-				} else {
-					subType = -1;
+void IOMarket::getOwnHistory(uint32_t playerId, HistoryCallback callback)
+{
+	g_databaseTasks.addTask(fmt::format("SELECT `sale`, `itemtype`, `amount`, `price`, `expires_at`, `state` FROM `market_history` WHERE `player_id` = {:d}", playerId), [callback](DBResult_ptr result, bool) {
+		HistoryMarketOfferList buyOffers;
+		HistoryMarketOfferList sellOffers;
+		if (result) {
+			do {
+				HistoryMarketOffer offer;
+				offer.itemId = result->getNumber<uint16_t>("itemtype");
+				offer.amount = result->getNumber<uint16_t>("amount");
+				offer.price = result->getNumber<uint32_t>("price");
+				offer.timestamp = result->getNumber<uint32_t>("expires_at");
+
+				MarketOfferState_t offerState = static_cast<MarketOfferState_t>(result->getNumber<uint16_t>("state"));
+				if (offerState == OFFERSTATE_ACCEPTEDEX) {
+					offerState = OFFERSTATE_ACCEPTED;
 				}
 
-				for (uint16_t i = 0; i < amount; ++i) {
-					Item* item = Item::CreateItem(itemType.id, subType);
-					if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
-						delete item;
-						break;
-					}
+				offer.state = offerState;
+
+				if (result->getNumber<uint16_t>("sale") == MARKETACTION_BUY) {
+					buyOffers.push_back(offer);
+				} else {
+					sellOffers.push_back(offer);
 				}
-			}
+			} while (result->next());
+		}
+		callback(buyOffers, sellOffers);
+	}, true);
+}
 
-			if (player->isOffline()) {
-				IOLoginData::savePlayer(player);
-				delete player;
-			}
+ItemList IOMarket::createOfferItems(const ItemType& itemType, uint16_t amount)
+{
+	ItemList items;
+	if (itemType.stackable) {
+		while (amount > 0) {
+			uint16_t stackCount = std::min<uint16_t>(100, amount);
+			items.push_back(Item::CreateItem(itemType.id, stackCount));
+			amount -= stackCount;
+		}
+	} else {
+		int32_t subType;
+		if (itemType.charges != 0) {
+			subType = itemType.charges;
 		} else {
-			uint64_t totalPrice = result->getNumber<uint64_t>("price") * amount;
-
-			Player* player = g_game.getPlayerByGUID(playerId);
-			if (player) {
-				player->setBankBalance(player->getBankBalance() + totalPrice);
-			} else {
-				IOLoginData::increaseBankBalance(playerId, totalPrice);
-			}
+			subType = -1;
 		}
-	} while (result->next());
+
+		for (uint16_t i = 0; i < amount; ++i) {
+			items.push_back(Item::CreateItem(itemType.id, subType));
+		}
+	}
+	return items;
+}
+
+void IOMarket::expireOffer(const Offer& offer)
+{
+	if (offer.type == MARKETACTION_SELL) {
+		const ItemType& itemType = Item::items[offer.itemId];
+		if (itemType.id == 0) {
+			return;
+		}
+
+		IODelivery::deliverItems(offer.playerId, createOfferItems(itemType, offer.amount));
+	} else {
+		IODelivery::deliverBankBalance(offer.playerId, static_cast<uint64_t>(offer.price) * offer.amount);
+	}
 }
 
 void IOMarket::checkExpiredOffers()
 {
+	IOMarket& market = getInstance();
+
 	const time_t lastExpireDate = time(nullptr) - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
 
-	g_databaseTasks.addTask(fmt::format("SELECT `id`, `amount`, `price`, `itemtype`, `player_id`, `sale` FROM `market_offers` WHERE `created` <= {:d}", lastExpireDate), IOMarket::processExpiredOffers, true);
+	// oldest offers first, stops at the first one still running
+	while (!market.expiry.empty() && market.expiry.begin()->first <= lastExpireDate) {
+		auto it = market.offers.find(market.expiry.begin()->second);
+		Offer offer = it->second;
+		market.removeOffer(it);
+
+		g_databaseTasks.addTask(fmt::format("DELETE FROM `market_offers` WHERE `id` = {:d}", offer.id));
+		appendHistory(offer.playerId, offer.type, offer.itemId, offer.amount, offer.price, offer.created + g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION), OFFERSTATE_EXPIRED);
+		market.expireOffer(offer);
+	}
 
 	int32_t checkExpiredMarketOffersEachMinutes = g_config.getNumber(ConfigManager::CHECK_EXPIRED_MARKET_OFFERS_EACH_MINUTES);
 	if (checkExpiredMarketOffersEachMinutes <= 0) {
@@ -184,78 +230,115 @@ void IOMarket::checkExpiredOffers()
 
 uint32_t IOMarket::getPlayerOfferCount(uint32_t playerId)
 {
-	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT COUNT(*) AS `count` FROM `market_offers` WHERE `player_id` = {:d}", playerId));
-	if (!result) {
+	IOMarket& market = getInstance();
+
+	auto it = market.playerOffers.find(playerId);
+	if (it == market.playerOffers.end()) {
 		return 0;
 	}
-	return result->getNumber<int32_t>("count");
+	return it->second.size();
 }
 
 MarketOfferEx IOMarket::getOfferByCounter(uint32_t timestamp, uint16_t counter)
 {
+	IOMarket& market = getInstance();
+
 	MarketOfferEx offer;
 
-	const int32_t created = timestamp - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+	const uint32_t created = timestamp - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+	for (auto it = market.expiry.lower_bound({created, 0}); it != market.expiry.end() && it->first == created; ++it) {
+		if ((it->second & 0xFFFF) != counter) {
+			continue;
+		}
 
-	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `id`, `sale`, `itemtype`, `amount`, `created`, `price`, `player_id`, `anonymous`, (SELECT `name` FROM `players` WHERE `id` = `player_id`) AS `player_name` FROM `market_offers` WHERE `created` = {:d} AND (`id` & 65535) = {:d} LIMIT 1", created, counter));
-	if (!result) {
-		offer.id = 0;
-		offer.playerId = 0;
+		const Offer& marketOffer = market.offers[it->second];
+		offer.id = marketOffer.id;
+		offer.type = marketOffer.type;
+		offer.amount = marketOffer.amount;
+		offer.counter = marketOffer.id & 0xFFFF;
+		offer.timestamp = marketOffer.created;
+		offer.price = marketOffer.price;
+		offer.itemId = marketOffer.itemId;
+		offer.playerId = marketOffer.playerId;
+		if (!marketOffer.anonymous) {
+			offer.playerName = marketOffer.playerName;
+		} else {
+			offer.playerName = "Anonymous";
+		}
 		return offer;
 	}
 
-	offer.id = result->getNumber<uint32_t>("id");
-	offer.type = static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale"));
-	offer.amount = result->getNumber<uint16_t>("amount");
-	offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-	offer.timestamp = result->getNumber<uint32_t>("created");
-	offer.price = result->getNumber<uint32_t>("price");
-	offer.itemId = result->getNumber<uint16_t>("itemtype");
-	offer.playerId = result->getNumber<uint32_t>("player_id");
-	if (result->getNumber<uint16_t>("anonymous") == 0) {
-		offer.playerName = result->getString("player_name");
-	} else {
-		offer.playerName = "Anonymous";
-	}
+	offer.id = 0;
+	offer.playerId = 0;
 	return offer;
 }
 
-void IOMarket::createOffer(uint32_t playerId, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous)
+void IOMarket::createOffer(uint32_t playerId, const std::string& playerName, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous)
 {
-	Database::getInstance().executeQuery(fmt::format("INSERT INTO `market_offers` (`player_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`) VALUES ({:d}, {:d}, {:d}, {:d}, {:d}, {:d}, {:d})", playerId, action, itemId, amount, price, time(nullptr), anonymous));
+	IOMarket& market = getInstance();
+
+	Offer offer;
+	offer.id = market.nextOfferId;
+	offer.playerId = playerId;
+	offer.playerName = playerName;
+	offer.type = action;
+	offer.itemId = itemId;
+	offer.amount = amount;
+	offer.price = price;
+	offer.created = time(nullptr);
+	offer.anonymous = anonymous;
+
+	g_databaseTasks.addTask(fmt::format("INSERT INTO `market_offers` (`id`, `player_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`) VALUES ({:d}, {:d}, {:d}, {:d}, {:d}, {:d}, {:d}, {:d})", offer.id, playerId, action, itemId, amount, price, offer.created, anonymous));
+	market.addOffer(std::move(offer));
 }
 
 void IOMarket::acceptOffer(uint32_t offerId, uint16_t amount)
 {
-	Database::getInstance().executeQuery(fmt::format("UPDATE `market_offers` SET `amount` = `amount` - {:d} WHERE `id` = {:d}", amount, offerId));
+	IOMarket& market = getInstance();
+
+	auto it = market.offers.find(offerId);
+	if (it != market.offers.end()) {
+		it->second.amount -= std::min(it->second.amount, amount);
+	}
+
+	g_databaseTasks.addTask(fmt::format("UPDATE `market_offers` SET `amount` = `amount` - {:d} WHERE `id` = {:d}", amount, offerId));
 }
 
 void IOMarket::deleteOffer(uint32_t offerId)
 {
-	Database::getInstance().executeQuery(fmt::format("DELETE FROM `market_offers` WHERE `id` = {:d}", offerId));
+	IOMarket& market = getInstance();
+
+	auto it = market.offers.find(offerId);
+	if (it != market.offers.end()) {
+		market.removeOffer(it);
+	}
+
+	g_databaseTasks.addTask(fmt::format("DELETE FROM `market_offers` WHERE `id` = {:d}", offerId));
 }
 
 void IOMarket::appendHistory(uint32_t playerId, MarketAction_t type, uint16_t itemId, uint16_t amount, uint32_t price, time_t timestamp, MarketOfferState_t state)
 {
+	if (state == OFFERSTATE_ACCEPTED) {
+		getInstance().addTransaction(type, itemId, price);
+	}
+
 	g_databaseTasks.addTask(fmt::format("INSERT INTO `market_history` (`player_id`, `sale`, `itemtype`, `amount`, `price`, `expires_at`, `inserted`, `state`) VALUES ({:d}, {:d}, {:d}, {:d}, {:d}, {:d}, {:d}, {:d})", playerId, type, itemId, amount, price, timestamp, time(nullptr), state));
 }
 
 bool IOMarket::moveOfferToHistory(uint32_t offerId, MarketOfferState_t state)
 {
-	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
-
-	Database& db = Database::getInstance();
+	IOMarket& market = getInstance();
 
-	DBResult_ptr result = db.storeQuery(fmt::format("SELECT `player_id`, `sale`, `itemtype`, `amount`, `price`, `created` FROM `market_offers` WHERE `id` = {:d}", offerId));
-	if (!result) {
+	auto it = market.offers.find(offerId);
+	if (it == market.offers.end()) {
 		return false;
 	}
 
-	if (!db.executeQuery(fmt::format("DELETE FROM `market_offers` WHERE `id` = {:d}", offerId))) {
-		return false;
-	}
+	Offer offer = it->second;
+	market.removeOffer(it);
 
-	appendHistory(result->getNumber<uint32_t>("player_id"), static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale")), result->getNumber<uint16_t>("itemtype"), result->getNumber<uint16_t>("amount"), result->getNumber<uint32_t>("price"), result->getNumber<uint32_t>("created") + marketOfferDuration, state);
+	g_databaseTasks.addTask(fmt::format("DELETE FROM `market_offers` WHERE `id` = {:d}", offerId));
+	appendHistory(offer.playerId, offer.type, offer.itemId, offer.amount, offer.price, offer.created + g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION), state);
 	return true;
 }
 
@@ -281,6 +364,22 @@ void IOMarket::updateStatistics()
 	} while (result->next());
 }
 
+void IOMarket::addTransaction(MarketAction_t type, uint16_t itemId, uint32_t price)
+{
+	// same figures as the statistics query over the accepted history rows
+	MarketStatistics& statistics = type == MARKETACTION_BUY ? purchaseStatistics[itemId] : saleStatistics[itemId];
+	if (statistics.numTransactions == 0) {
+		statistics.lowestPrice = price;
+		statistics.highestPrice = price;
+	} else {
+		statistics.lowestPrice = std::min(statistics.lowestPrice, price);
+		statistics.highestPrice = std::max(statistics.highestPrice, price);
+	}
+
+	++statistics.numTransactions;
+	statistics.totalPrice += price;
+}
+
 MarketStatistics* IOMarket::getPurchaseStatistics(uint16_t itemId)
 {
 	auto it = purchaseStatistics.find(itemId);
@@ -6,7 +6,12 @@
 
 #include "enums.h"
 #include "database.h"
+#include "item.h"
 
+#include <set>
+
+// The active offers are loaded once at startup and served from memory, the
+// market_offers table is written behind through the database task queue.
 class IOMarket
 {
 	public:
@@ -15,23 +20,31 @@ class IOMarket
 			return instance;
 		}
 
+		using HistoryCallback = std::function<void(const HistoryMarketOfferList& buyOffers, const HistoryMarketOfferList& sellOffers)>;
+
+		void loadOffers();
+
 		static MarketOfferList getActiveOffers(MarketAction_t action, uint16_t itemId);
 		static MarketOfferList getOwnOffers(MarketAction_t action, uint32_t playerId);
-		static HistoryMarketOfferList getOwnHistory(MarketAction_t action, uint32_t playerId);
+		// the history is only read on request, callback runs on the dispatcher
+		// once the queued history writes before it are done
+		static void getOwnHistory(uint32_t playerId, HistoryCallback callback);
 
-		static void processExpiredOffers(DBResult_ptr result, bool);
 		static void checkExpiredOffers();
 
 		static uint32_t getPlayerOfferCount(uint32_t playerId);
 		static MarketOfferEx getOfferByCounter(uint32_t timestamp, uint16_t counter);
 
-		static void createOffer(uint32_t playerId, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous);
+		static void createOffer(uint32_t playerId, const std::string& playerName, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous);
 		static void acceptOffer(uint32_t offerId, uint16_t amount);
 		static void deleteOffer(uint32_t offerId);
 
 		static void appendHistory(uint32_t playerId, MarketAction_t type, uint16_t itemId, uint16_t amount, uint32_t price, time_t timestamp, MarketOfferState_t state);
 		static bool moveOfferToHistory(uint32_t offerId, MarketOfferState_t state);
 
+		// the items of an offer, stackables in stacks of 100
+		static ItemList createOfferItems(const ItemType& itemType, uint16_t amount);
+
 		void updateStatistics();
 
 		MarketStatistics* getPurchaseStatistics(uint16_t itemId);
@@ -40,6 +53,35 @@ class IOMarket
 	private:
 		IOMarket() = default;
 
+		struct Offer {
+			std::string playerName;
+			uint32_t id;
+			uint32_t playerId;
+			uint32_t created;
+			uint32_t price;
+			uint16_t amount;
+			uint16_t itemId;
+			MarketAction_t type;
+			bool anonymous;
+		};
+
+		using BookKey = std::pair<uint16_t, MarketAction_t>;
+		using PriceKey = std::pair<uint32_t, uint32_t>; // price, offer id
+		using ExpiryKey = std::pair<uint32_t, uint32_t>; // created, offer id
+
+		void addOffer(Offer&& offer);
+		void removeOffer(std::map<uint32_t, Offer>::iterator it);
+		void expireOffer(const Offer& offer);
+		void addTransaction(MarketAction_t type, uint16_t itemId, uint32_t price);
+
+		static MarketOffer toMarketOffer(const Offer& offer);
+
+		std::map<uint32_t, Offer> offers;
+		std::map<BookKey, std::set<PriceKey>> book;
+		std::map<uint32_t, std::set<uint32_t>> playerOffers;
+		std::set<ExpiryKey> expiry;
+		uint32_t nextOfferId = 1;
+
 		std::map<uint16_t, MarketStatistics> purchaseStatistics;
 		std::map<uint16_t, MarketStatistics> saleStatistics;
 };
@@ -18,6 +18,7 @@
 #include <random>
 #include <algorithm>
 #include <cstdint>
+#include <shared_mutex>
 
 #include "actions.h"
 #include "spells.h"
@@ -27,6 +28,7 @@ extern Spells* g_spells;
 extern Vocations g_vocations;
 
 Items Item::items;
+thread_local std::vector<std::pair<Item*, uint16_t>>* Item::deferredUniqueIds = nullptr;
 
 struct RarityAttributes {
     int numAbsorbs;
@@ -36,7 +38,8 @@ struct RarityAttributes {
 };
 
 void Item::applyRarityEffects(Item* item) {
-    const auto rarityAttr = item->getCustomAttribute("rarity");
+    static const ItemAttributes::CustomAttributeKey rarityKey = ItemAttributes::getCustomAttributeKey("rarity");
+    const auto rarityAttr = item->getCustomAttribute(rarityKey);
     if (!rarityAttr) {
         return;
     }
@@ -108,7 +111,8 @@ void Item::applyRarityEffects(Item* item) {
 
     const ItemType& it = Item::items[item->getID()];
 
-    if (item->getCustomAttribute("combatPowerLevel"))
+    static const ItemAttributes::CustomAttributeKey combatPowerLevelKey = ItemAttributes::getCustomAttributeKey("combatPowerLevel");
+    if (item->getCustomAttribute(combatPowerLevelKey))
         return;
 
     const uint32_t VALID_EQUIP_SLOTS =
@@ -398,7 +402,8 @@ Item* Item::CreateItem(const uint16_t type, uint16_t count /*= 0*/)
 		} else {
 			newItem = new Item(type, count);
 		}
-		if(newItem && newItem->getCustomAttribute("rarity")) {
+		static const ItemAttributes::CustomAttributeKey rarityKey = ItemAttributes::getCustomAttributeKey("rarity");
+		if(newItem && newItem->getCustomAttribute(rarityKey)) {
     		applyRarityEffects(newItem);
 		}
 
@@ -725,7 +730,11 @@ Attr_ReadValue Item::readAttr(AttrTypes_t attr, PropStream& propStream)
 				return ATTR_READ_ERROR;
 			}
 
-			setUniqueId(uniqueId);
+			if (deferredUniqueIds) {
+				deferredUniqueIds->emplace_back(this, uniqueId);
+			} else {
+				setUniqueId(uniqueId);
+			}
 			break;
 		}
 
@@ -1033,7 +1042,7 @@ Attr_ReadValue Item::readAttr(AttrTypes_t attr, PropStream& propStream)
 					return ATTR_READ_ERROR;
 				}
 
-				setCustomAttribute(key, val);
+				getAttributes()->setCustomAttribute(ItemAttributes::getCustomAttributeKey(key), std::move(val));
 			}
 			break;
 		}
@@ -1202,7 +1211,7 @@ void Item::serializeAttr(PropWriteStream& propWriteStream) const
 		propWriteStream.write<uint64_t>(static_cast<uint64_t>(customAttrMap->size()));
 		for (const auto &entry : *customAttrMap) {
 			// Serializing key type and value
-			propWriteStream.writeString(entry.first);
+			propWriteStream.writeString(ItemAttributes::getCustomAttributeKeyName(entry.first));
 
 			// Serializing value type and value
 			entry.second.serialize(propWriteStream);
@@ -2452,7 +2461,8 @@ void Item::getTooltipData(Item* item, uint16_t spriteId, uint16_t count, Tooltip
 void Item::getRarityLevel(TooltipDataContainer& tooltipData)
 {
     int rarity = 0;
-    const auto rarityId = getCustomAttribute("rarity");
+    static const ItemAttributes::CustomAttributeKey rarityKey = ItemAttributes::getCustomAttributeKey("rarity");
+    const auto rarityId = getCustomAttribute(rarityKey);
     if (rarityId) {
         const auto& value = rarityId->value;
         if (value.type() == typeid(int64_t)) {
@@ -2467,6 +2477,83 @@ void Item::getRarityLevel(TooltipDataContainer& tooltipData)
     }
 }
 
+namespace {
+
+// keys are also interned by the map loader threads, names is a deque so
+// references returned by getCustomAttributeKeyName stay valid. Lookups only
+// share the lock, it is exclusive while a new key is added.
+struct CustomAttributeKeys {
+	std::unordered_map<std::string, ItemAttributes::CustomAttributeKey> ids;
+	std::deque<std::string> names;
+	std::shared_mutex lock;
+};
+
+CustomAttributeKeys& getCustomAttributeKeys()
+{
+	static CustomAttributeKeys keys;
+	return keys;
+}
+
+}
+
+ItemAttributes::CustomAttributeKey ItemAttributes::getCustomAttributeKey(const std::string& name)
+{
+	CustomAttributeKeys& keys = getCustomAttributeKeys();
+	std::string lowerName = asLowerCaseString(name);
+	{
+		std::shared_lock<std::shared_mutex> lockGuard(keys.lock);
+		auto it = keys.ids.find(lowerName);
+		if (it != keys.ids.end()) {
+			return it->second;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> lockGuard(keys.lock);
+	auto it = keys.ids.find(lowerName);
+	if (it != keys.ids.end()) {
+		return it->second;
+	}
+
+	CustomAttributeKey key = static_cast<CustomAttributeKey>(keys.names.size());
+	keys.names.push_back(lowerName);
+	keys.ids.emplace(std::move(lowerName), key);
+	return key;
+}
+
+bool ItemAttributes::findCustomAttributeKey(const std::string& name, CustomAttributeKey& key)
+{
+	CustomAttributeKeys& keys = getCustomAttributeKeys();
+	std::string lowerName = asLowerCaseString(name);
+
+	std::shared_lock<std::shared_mutex> lockGuard(keys.lock);
+	auto it = keys.ids.find(lowerName);
+	if (it == keys.ids.end()) {
+		return false;
+	}
+
+	key = it->second;
+	return true;
+}
+
+bool ItemAttributes::isCustomAttributeKey(uint32_t id)
+{
+	CustomAttributeKeys& keys = getCustomAttributeKeys();
+	std::shared_lock<std::shared_mutex> lockGuard(keys.lock);
+	return id < keys.names.size();
+}
+
+const std::string& ItemAttributes::getCustomAttributeKeyName(CustomAttributeKey key)
+{
+	CustomAttributeKeys& keys = getCustomAttributeKeys();
+	size_t id = static_cast<size_t>(key);
+
+	std::shared_lock<std::shared_mutex> lockGuard(keys.lock);
+	if (id >= keys.names.size()) {
+		return emptyString;
+	}
+	return keys.names[id];
+}
+
 template<>
 const std::string& ItemAttributes::CustomAttribute::get<std::string>() {
 	if (value.type() == typeid(std::string)) {
@@ -8,9 +8,11 @@
 #include "thing.h"
 #include "items.h"
 #include "luascript.h"
+#include "objectpool.h"
 #include "tools.h"
 #include <typeinfo>
 
+#include <boost/container/small_vector.hpp>
 #include <boost/variant.hpp>
 #include <deque>
 
@@ -205,6 +207,14 @@ class ItemAttributes
 			return static_cast<ItemDecayState_t>(getIntAttr(ITEM_ATTRIBUTE_DECAYSTATE));
 		}
 
+		// custom attribute names are interned once into small ids, keys are case insensitive
+		enum class CustomAttributeKey : uint32_t {};
+
+		static CustomAttributeKey getCustomAttributeKey(const std::string& name);
+		static bool findCustomAttributeKey(const std::string& name, CustomAttributeKey& key);
+		static bool isCustomAttributeKey(uint32_t id);
+		static const std::string& getCustomAttributeKeyName(CustomAttributeKey key);
+
 		struct CustomAttribute
 		{
 			typedef boost::variant<boost::blank, std::string, int64_t, double, bool> VariantAttribute;
@@ -348,7 +358,9 @@ class ItemAttributes
 		static double emptyDouble;
 		static bool emptyBool;
 
-		typedef std::unordered_map<std::string, CustomAttribute> CustomAttributeMap;
+		// kept sorted by key, most items only carry a handful of custom attributes
+		typedef std::pair<CustomAttributeKey, CustomAttribute> CustomAttributeEntry;
+		typedef boost::container::small_vector<CustomAttributeEntry, 4> CustomAttributeMap;
 
 		struct Attribute
 		{
@@ -435,45 +447,45 @@ class ItemAttributes
 
 		template<typename R>
 		void setCustomAttribute(int64_t key, R value) {
-			auto tmp = std::to_string(key);
-			setCustomAttribute(tmp, value);
+			setCustomAttribute(getCustomAttributeKey(std::to_string(key)), CustomAttribute(value));
 		}
 
-		void setCustomAttribute(int64_t key, CustomAttribute& value) {
-			auto tmp = std::to_string(key);
-			setCustomAttribute(tmp, value);
+		template<typename R>
+		void setCustomAttribute(const std::string& key, R value) {
+			setCustomAttribute(getCustomAttributeKey(key), CustomAttribute(value));
 		}
 
-		template<typename R>
-		void setCustomAttribute(std::string& key, R value) {
-			toLowerCaseString(key);
-			if (hasAttribute(ITEM_ATTRIBUTE_CUSTOM)) {
-				removeCustomAttribute(key);
-			} else {
-				getAttr(ITEM_ATTRIBUTE_CUSTOM).value.custom = new CustomAttributeMap();
+		void setCustomAttribute(CustomAttributeKey key, CustomAttribute value) {
+			CustomAttributeMap* customAttrMap = getCustomAttributeMap();
+			if (!customAttrMap) {
+				customAttrMap = new CustomAttributeMap();
+				getAttr(ITEM_ATTRIBUTE_CUSTOM).value.custom = customAttrMap;
 			}
-			getAttr(ITEM_ATTRIBUTE_CUSTOM).value.custom->emplace(key, value);
-		}
 
-		void setCustomAttribute(std::string& key, CustomAttribute& value) {
-			toLowerCaseString(key);
-			if (hasAttribute(ITEM_ATTRIBUTE_CUSTOM)) {
-				removeCustomAttribute(key);
+			auto it = lowerBoundCustomAttribute(*customAttrMap, key);
+			if (it != customAttrMap->end() && it->first == key) {
+				it->second = std::move(value);
 			} else {
-				getAttr(ITEM_ATTRIBUTE_CUSTOM).value.custom = new CustomAttributeMap();
+				customAttrMap->emplace(it, key, std::move(value));
 			}
-			getAttr(ITEM_ATTRIBUTE_CUSTOM).value.custom->insert(std::make_pair(std::move(key), std::move(value)));
 		}
 
 		const CustomAttribute* getCustomAttribute(int64_t key) {
-			auto tmp = std::to_string(key);
-			return getCustomAttribute(tmp);
+			return getCustomAttribute(std::to_string(key));
 		}
 
 		const CustomAttribute* getCustomAttribute(const std::string& key) {
-			if (const CustomAttributeMap* customAttrMap = getCustomAttributeMap()) {
-				auto it = customAttrMap->find(asLowerCaseString(key));
-				if (it != customAttrMap->end()) {
+			CustomAttributeKey id;
+			if (!findCustomAttributeKey(key, id)) {
+				return nullptr;
+			}
+			return getCustomAttribute(id);
+		}
+
+		const CustomAttribute* getCustomAttribute(CustomAttributeKey key) {
+			if (CustomAttributeMap* customAttrMap = getCustomAttributeMap()) {
+				auto it = lowerBoundCustomAttribute(*customAttrMap, key);
+				if (it != customAttrMap->end() && it->first == key) {
 					return &(it->second);
 				}
 			}
@@ -481,14 +493,21 @@ class ItemAttributes
 		}
 
 		bool removeCustomAttribute(int64_t key) {
-			auto tmp = std::to_string(key);
-			return removeCustomAttribute(tmp);
+			return removeCustomAttribute(std::to_string(key));
 		}
 
 		bool removeCustomAttribute(const std::string& key) {
+			CustomAttributeKey id;
+			if (!findCustomAttributeKey(key, id)) {
+				return false;
+			}
+			return removeCustomAttribute(id);
+		}
+
+		bool removeCustomAttribute(CustomAttributeKey key) {
 			if (CustomAttributeMap* customAttrMap = getCustomAttributeMap()) {
-				auto it = customAttrMap->find(asLowerCaseString(key));
-				if (it != customAttrMap->end()) {
+				auto it = lowerBoundCustomAttribute(*customAttrMap, key);
+				if (it != customAttrMap->end() && it->first == key) {
 					customAttrMap->erase(it);
 					return true;
 				}
@@ -496,6 +515,12 @@ class ItemAttributes
 			return false;
 		}
 
+		static CustomAttributeMap::iterator lowerBoundCustomAttribute(CustomAttributeMap& customAttrMap, CustomAttributeKey key) {
+			return std::lower_bound(customAttrMap.begin(), customAttrMap.end(), key, [](const CustomAttributeEntry& entry, CustomAttributeKey key) {
+				return entry.first < key;
+			});
+		}
+
 		const static uint32_t intAttributeTypes = ITEM_ATTRIBUTE_ACTIONID | ITEM_ATTRIBUTE_UNIQUEID | ITEM_ATTRIBUTE_DATE
 			| ITEM_ATTRIBUTE_WEIGHT | ITEM_ATTRIBUTE_ATTACK | ITEM_ATTRIBUTE_DEFENSE | ITEM_ATTRIBUTE_EXTRADEFENSE
 			| ITEM_ATTRIBUTE_ARMOR | ITEM_ATTRIBUTE_HITCHANCE | ITEM_ATTRIBUTE_SHOOTRANGE | ITEM_ATTRIBUTE_OWNER
@@ -531,6 +556,11 @@ class Item : virtual public Thing
 		static Container* CreateItemAsContainer(const uint16_t type, uint16_t size);
 		static Item* CreateItem(PropStream& propStream);
 		static Items items;
+
+		// while set, unique ids read from attributes are collected here
+		// instead of being registered, used by the map loader threads
+		static thread_local std::vector<std::pair<Item*, uint16_t>>* deferredUniqueIds;
+
 		static Item* CreateItemWithRarity(const uint16_t type, uint16_t count, int rarityId);
     	static void applyRarityEffects(Item* item);
 
@@ -544,6 +574,14 @@ class Item : virtual public Thing
 		// non-assignable
 		Item& operator=(const Item&) = delete;
 
+		// covers every derived item through the virtual destructor
+		static void* operator new(size_t size) {
+			return ObjectPool::getItemPool().allocate(size);
+		}
+		static void operator delete(void* p, size_t size) {
+			ObjectPool::getItemPool().deallocate(p, size);
+		}
+
 		bool equals(const Item* otherItem) const;
 
 		Item* getItem() override final {
@@ -625,12 +663,13 @@ class Item : virtual public Thing
 		}
 
 		template<typename R>
-		void setCustomAttribute(std::string& key, R value) {
+		void setCustomAttribute(const std::string& key, R value) {
 			getAttributes()->setCustomAttribute(key, value);
 		}
 
-		void setCustomAttribute(std::string& key, ItemAttributes::CustomAttribute& value) {
-			getAttributes()->setCustomAttribute(key, value);
+		template<typename R>
+		void setCustomAttribute(ItemAttributes::CustomAttributeKey key, R value) {
+			getAttributes()->setCustomAttribute(key, ItemAttributes::CustomAttribute(value));
 		}
 
 		const ItemAttributes::CustomAttribute* getCustomAttribute(int64_t key) {
@@ -647,6 +686,13 @@ class Item : virtual public Thing
 			return getAttributes()->getCustomAttribute(key);
 		}
 
+		const ItemAttributes::CustomAttribute* getCustomAttribute(ItemAttributes::CustomAttributeKey key) {
+			if (!attributes) {
+				return nullptr;
+			}
+			return getAttributes()->getCustomAttribute(key);
+		}
+
 		bool removeCustomAttribute(int64_t key) {
 			if (!attributes) {
 				return false;
@@ -661,6 +707,13 @@ class Item : virtual public Thing
 			return getAttributes()->removeCustomAttribute(key);
 		}
 
+		bool removeCustomAttribute(ItemAttributes::CustomAttributeKey key) {
+			if (!attributes) {
+				return false;
+			}
+			return getAttributes()->removeCustomAttribute(key);
+		}
+
 		void setSpecialDescription(const std::string& desc) {
 			setStrAttr(ITEM_ATTRIBUTE_DESCRIPTION, desc);
 		}
@@ -1068,13 +1121,14 @@ class Item : virtual public Thing
 	private:
 		std::string getWeightDescription(uint32_t weight) const;
 
+		// packed next to id, map items are the bulk of all items
+		uint8_t count = 1; // number of stacked items
+		bool loadedFromMap = false;
+
 		std::unique_ptr<ItemAttributes> attributes;
 
 		uint32_t referenceCounter = 0;
-
-		uint8_t count = 1; // number of stacked items
 		uint32_t realUId = 0;
-		bool loadedFromMap = false;
 
 		//Don't add variables here, use the ItemAttribute class.
 };
@@ -0,0 +1,207 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "loadergraph.h"
+
+#include <fmt/format.h>
+
+void LoaderGraph::addWorkerTask(std::string name, std::vector<std::string> dependencies, std::string failureMessage, Loader loader)
+{
+	addTask(std::move(name), std::move(dependencies), std::move(failureMessage), std::move(loader), false);
+}
+
+void LoaderGraph::addMainTask(std::string name, std::vector<std::string> dependencies, std::string failureMessage, Loader loader)
+{
+	addTask(std::move(name), std::move(dependencies), std::move(failureMessage), std::move(loader), true);
+}
+
+void LoaderGraph::addTask(std::string name, std::vector<std::string> dependencies, std::string failureMessage, Loader loader, bool mainThread)
+{
+	Task task;
+	task.name = std::move(name);
+	task.dependencyNames = std::move(dependencies);
+	task.failureMessage = std::move(failureMessage);
+	task.loader = std::move(loader);
+	task.mainThread = mainThread;
+	tasks.push_back(std::move(task));
+}
+
+bool LoaderGraph::resolveDependencies()
+{
+	std::map<std::string, size_t> taskIds;
+	for (size_t i = 0; i < tasks.size(); ++i) {
+		if (!taskIds.emplace(tasks[i].name, i).second) {
+			error = fmt::format("Duplicate startup loader {:s}.", tasks[i].name);
+			return false;
+		}
+	}
+
+	for (Task& task : tasks) {
+		for (const std::string& dependencyName : task.dependencyNames) {
+			auto it = taskIds.find(dependencyName);
+			if (it == taskIds.end()) {
+				error = fmt::format("Startup loader {:s} depends on unknown loader {:s}.", task.name, dependencyName);
+				return false;
+			}
+			task.dependencies.push_back(it->second);
+		}
+	}
+	return true;
+}
+
+bool LoaderGraph::isReady(const Task& task) const
+{
+	if (task.state != TASK_PENDING) {
+		return false;
+	}
+
+	for (size_t dependency : task.dependencies) {
+		if (tasks[dependency].state != TASK_DONE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+LoaderGraph::Task* LoaderGraph::getReadyWorkerTask()
+{
+	for (Task& task : tasks) {
+		if (!task.mainThread && isReady(task)) {
+			return &task;
+		}
+	}
+	return nullptr;
+}
+
+bool LoaderGraph::run()
+{
+	startTime = std::chrono::steady_clock::now();
+	if (!resolveDependencies()) {
+		return false;
+	}
+
+	size_t workerTasks = std::count_if(tasks.begin(), tasks.end(), [](const Task& task) { return !task.mainThread; });
+	threadCount = std::min<size_t>(std::max<uint32_t>(1, std::thread::hardware_concurrency()), workerTasks);
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		workers.emplace_back(&LoaderGraph::workerThread, this, i + 1);
+	}
+
+	std::unique_lock<std::mutex> lockGuard(lock);
+	auto nextMainTask = tasks.begin();
+	while (!stopped) {
+		while (nextMainTask != tasks.end() && (!nextMainTask->mainThread || nextMainTask->state != TASK_PENDING)) {
+			++nextMainTask;
+		}
+
+		if (nextMainTask != tasks.end() && isReady(*nextMainTask)) {
+			nextMainTask->state = TASK_RUNNING;
+			++running;
+
+			lockGuard.unlock();
+			runTask(*nextMainTask, 0);
+			lockGuard.lock();
+			continue;
+		}
+
+		if (std::all_of(tasks.begin(), tasks.end(), [](const Task& task) { return task.state == TASK_DONE; })) {
+			break;
+		}
+
+		if (running == 0 && !getReadyWorkerTask()) {
+			// nothing can make progress anymore, the remaining tasks wait on each other
+			std::string pending;
+			for (const Task& task : tasks) {
+				if (task.state == TASK_PENDING) {
+					if (!pending.empty()) {
+						pending.append(", ");
+					}
+					pending.append(task.name);
+				}
+			}
+			error = fmt::format("Circular dependency between startup loaders: {:s}.", pending);
+			break;
+		}
+
+		signal.wait(lockGuard);
+	}
+
+	stopped = true;
+	lockGuard.unlock();
+	signal.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+	return error.empty();
+}
+
+void LoaderGraph::workerThread(size_t thread)
+{
+	std::unique_lock<std::mutex> lockGuard(lock);
+	while (!stopped) {
+		Task* task = getReadyWorkerTask();
+		if (!task) {
+			signal.wait(lockGuard);
+			continue;
+		}
+
+		task->state = TASK_RUNNING;
+		++running;
+
+		lockGuard.unlock();
+		runTask(*task, thread);
+		lockGuard.lock();
+	}
+}
+
+void LoaderGraph::runTask(Task& task, size_t thread)
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(lock);
+		std::cout << ">> Loading " << task.name << std::endl;
+	}
+
+	auto taskStart = std::chrono::steady_clock::now();
+	bool success = task.loader();
+	auto taskEnd = std::chrono::steady_clock::now();
+
+	task.thread = thread;
+	task.startTime = std::chrono::duration_cast<std::chrono::milliseconds>(taskStart - startTime).count();
+	task.duration = std::chrono::duration_cast<std::chrono::milliseconds>(taskEnd - taskStart).count();
+
+	{
+		std::lock_guard<std::mutex> lockGuard(lock);
+		--running;
+		if (success) {
+			task.state = TASK_DONE;
+		} else {
+			task.state = TASK_FAILED;
+			if (error.empty()) {
+				error = task.failureMessage;
+			}
+			stopped = true;
+		}
+	}
+	signal.notify_all();
+}
+
+void LoaderGraph::printTimings() const
+{
+	std::cout << ">> Startup loaders: " << tasks.size() << " tasks in " << duration << " ms on " << threadCount << " worker threads" << std::endl;
+	std::cout << fmt::format("{:>10s} {:>10s} {:>10s}  {:s}", "start (ms)", "time (ms)", "thread", "loader") << std::endl;
+	for (const Task& task : tasks) {
+		if (task.state == TASK_PENDING) {
+			continue;
+		}
+
+		std::string thread = task.thread == 0 ? "main" : fmt::format("worker {:d}", task.thread);
+		std::cout << fmt::format("{:>10d} {:>10d} {:>10s}  {:s}", task.startTime, task.duration, thread, task.name) << std::endl;
+	}
+}
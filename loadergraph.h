@@ -0,0 +1,73 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#ifndef FS_LOADERGRAPH_H_5D3AF1F149C84FDD8D8F8CC08DF91043
+#define FS_LOADERGRAPH_H_5D3AF1F149C84FDD8D8F8CC08DF91043
+
+#include <condition_variable>
+
+// Startup loaders with the loaders they depend on. Worker tasks only parse
+// data files and run on a thread pool as soon as their dependencies are
+// done, they must not touch lua or the game. Main tasks run on the calling
+// (dispatcher) thread in the order they were added.
+class LoaderGraph
+{
+	public:
+		using Loader = std::function<bool()>;
+
+		void addWorkerTask(std::string name, std::vector<std::string> dependencies, std::string failureMessage, Loader loader);
+		void addMainTask(std::string name, std::vector<std::string> dependencies, std::string failureMessage, Loader loader);
+
+		// runs every task, stops scheduling new tasks after the first failure
+		bool run();
+
+		const std::string& getError() const {
+			return error;
+		}
+
+		void printTimings() const;
+
+	private:
+		enum TaskState_t {
+			TASK_PENDING,
+			TASK_RUNNING,
+			TASK_DONE,
+			TASK_FAILED,
+		};
+
+		struct Task {
+			std::string name;
+			std::vector<std::string> dependencyNames;
+			std::vector<size_t> dependencies;
+			std::string failureMessage;
+			Loader loader;
+			bool mainThread;
+
+			TaskState_t state = TASK_PENDING;
+			size_t thread = 0; // 0 is the main thread
+			int64_t startTime = 0;
+			int64_t duration = 0;
+		};
+
+		void addTask(std::string name, std::vector<std::string> dependencies, std::string failureMessage, Loader loader, bool mainThread);
+		bool resolveDependencies();
+
+		bool isReady(const Task& task) const;
+		Task* getReadyWorkerTask();
+
+		void runTask(Task& task, size_t thread);
+		void workerThread(size_t thread);
+
+		std::vector<Task> tasks;
+		std::string error;
+
+		std::mutex lock;
+		std::condition_variable signal;
+		std::chrono::steady_clock::time_point startTime;
+		size_t running = 0;
+		size_t threadCount = 0;
+		int64_t duration = 0;
+		bool stopped = false;
+};
+
+#endif
@@ -0,0 +1,195 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include <fstream>
+
+#include "luaprofiler.h"
+
+extern LuaEnvironment g_luaEnvironment;
+
+LuaProfiler g_luaProfiler;
+
+void LuaProfiler::start(uint32_t sampleInterval /*= 0*/)
+{
+	this->sampleInterval = sampleInterval;
+	if (!enabled) {
+		startTime = std::chrono::steady_clock::now();
+	}
+	enabled = true;
+	attach(g_luaEnvironment.getLuaState());
+}
+
+void LuaProfiler::stop()
+{
+	enabled = false;
+	activeCallbacks.clear();
+
+	lua_State* L = g_luaEnvironment.getLuaState();
+	if (L) {
+		lua_sethook(L, nullptr, 0, 0);
+	}
+}
+
+void LuaProfiler::reset()
+{
+	callStats.clear();
+	samples.clear();
+	startTime = std::chrono::steady_clock::now();
+}
+
+void LuaProfiler::attach(lua_State* L)
+{
+	if (!L) {
+		return;
+	}
+
+	if (enabled && sampleInterval != 0) {
+		lua_sethook(L, sampleHook, LUA_MASKCOUNT, sampleInterval);
+	} else {
+		lua_sethook(L, nullptr, 0, 0);
+	}
+}
+
+void LuaProfiler::enterCallback(const ScriptEnvironment* env)
+{
+	int32_t scriptId;
+	int32_t callbackId;
+	bool timerEvent;
+	LuaScriptInterface* scriptInterface;
+	env->getEventInfo(scriptId, scriptInterface, callbackId, timerEvent);
+
+	ActiveCallback callback;
+	if (scriptInterface) {
+		callback.label = scriptInterface->getInterfaceName();
+		callback.label.push_back(';');
+		if (timerEvent) {
+			callback.label.append("addEvent;");
+		}
+		callback.label.append(scriptInterface->getFileById(scriptId));
+		if (callbackId) {
+			callback.label.push_back(';');
+			callback.label.append(scriptInterface->getFileById(callbackId));
+		}
+	} else {
+		callback.label = "(Unknown interface)";
+	}
+
+	if (!activeCallbacks.empty()) {
+		// nested call, e.g. an event fired from inside another script
+		callback.label = activeCallbacks.back().label + ';' + callback.label;
+	}
+
+	callback.startTime = std::chrono::steady_clock::now();
+	activeCallbacks.push_back(std::move(callback));
+}
+
+void LuaProfiler::leaveCallback()
+{
+	if (activeCallbacks.empty()) {
+		// profiler was started while the callback was running
+		return;
+	}
+
+	const ActiveCallback& callback = activeCallbacks.back();
+	uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - callback.startTime).count();
+
+	LuaProfilerCallStats& stats = callStats[callback.label];
+	++stats.calls;
+	stats.totalTime += elapsed;
+	stats.selfTime += elapsed - std::min(elapsed, callback.childTime);
+	stats.maxTime = std::max(stats.maxTime, elapsed);
+
+	activeCallbacks.pop_back();
+
+	// the parent line of the collapsed stacks must not count this time again
+	if (!activeCallbacks.empty()) {
+		activeCallbacks.back().childTime += elapsed;
+	}
+}
+
+void LuaProfiler::sampleHook(lua_State* L, lua_Debug*)
+{
+	g_luaProfiler.addSample(L);
+}
+
+void LuaProfiler::addSample(lua_State* L)
+{
+	std::vector<std::string> frames;
+
+	lua_Debug ar;
+	for (int level = 0; lua_getstack(L, level, &ar) != 0; ++level) {
+		if (lua_getinfo(L, "Sn", &ar) == 0) {
+			break;
+		}
+
+		std::string frame;
+		if (strcmp(ar.what, "C") == 0) {
+			frame = ar.name ? fmt::format("[C] {:s}", ar.name) : "[C]";
+		} else if (ar.name) {
+			frame = fmt::format("{:s}:{:d} {:s}", ar.short_src, ar.linedefined, ar.name);
+		} else {
+			frame = fmt::format("{:s}:{:d}", ar.short_src, ar.linedefined);
+		}
+		frames.push_back(std::move(frame));
+	}
+
+	std::string stack = activeCallbacks.empty() ? "(no callback)" : activeCallbacks.back().label;
+	for (auto it = frames.rbegin(), end = frames.rend(); it != end; ++it) {
+		stack.push_back(';');
+		stack.append(*it);
+	}
+	++samples[stack];
+}
+
+bool LuaProfiler::dump(const std::string& fileName) const
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file) {
+		std::cout << "[Error - LuaProfiler::dump] Could not open " << fileName << " for writing." << std::endl;
+		return false;
+	}
+
+	for (const auto& it : callStats) {
+		file << it.first << ' ' << it.second.selfTime << '\n';
+	}
+
+	if (!samples.empty()) {
+		std::ofstream samplesFile(fileName + ".samples", std::ios::trunc);
+		if (!samplesFile) {
+			std::cout << "[Error - LuaProfiler::dump] Could not open " << fileName << ".samples for writing." << std::endl;
+			return false;
+		}
+
+		for (const auto& it : samples) {
+			samplesFile << it.first << ' ' << it.second << '\n';
+		}
+	}
+	return true;
+}
+
+void LuaProfiler::printSummary(size_t limit /*= 20*/) const
+{
+	std::vector<std::pair<const std::string*, const LuaProfilerCallStats*>> sorted;
+	sorted.reserve(callStats.size());
+	for (const auto& it : callStats) {
+		sorted.emplace_back(&it.first, &it.second);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second->totalTime > rhs.second->totalTime;
+	});
+
+	if (sorted.size() > limit) {
+		sorted.resize(limit);
+	}
+
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << ">> Lua profiler: " << callStats.size() << " callbacks, " << samples.size() << " sampled stacks in " << duration << " ms" << std::endl;
+	std::cout << fmt::format("{:>10s} {:>12s} {:>10s} {:>10s}  {:s}", "calls", "total (ms)", "avg (us)", "max (us)", "callback") << std::endl;
+	for (const auto& it : sorted) {
+		const LuaProfilerCallStats& stats = *it.second;
+		std::cout << fmt::format("{:>10d} {:>12.3f} {:>10d} {:>10d}  {:s}", stats.calls, stats.totalTime / 1000., stats.totalTime / stats.calls, stats.maxTime, *it.first) << std::endl;
+	}
+}
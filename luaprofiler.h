@@ -0,0 +1,77 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#ifndef FS_LUAPROFILER_H_CBF4B7DA31274AFD81BBF64F8F6FEB36
+#define FS_LUAPROFILER_H_CBF4B7DA31274AFD81BBF64F8F6FEB36
+
+#include "luascript.h"
+
+static constexpr auto LUA_PROFILER_DUMP_FILE = "luaprofile.folded";
+
+struct LuaProfilerCallStats {
+	uint64_t calls = 0;
+	uint64_t totalTime = 0; // microseconds, including nested callbacks
+	uint64_t selfTime = 0; // microseconds, without nested callbacks
+	uint64_t maxTime = 0; // microseconds
+};
+
+// Optional profiler for the shared Lua state. When stopped the only cost is a
+// single branch in LuaScriptInterface::callFunction/callVoidFunction.
+//
+// Instrumenting mode: wall-clock time of every callback entered from C++,
+// keyed by "interface;script file:event".
+// Sampling mode: a count hook every sampleInterval VM instructions walks the
+// Lua stack and counts collapsed stacks below the running callback.
+// NOTE: LuaJIT does not fire count hooks inside compiled traces, so samples
+// only cover interpreted code there.
+class LuaProfiler
+{
+	public:
+		LuaProfiler() = default;
+
+		// non-copyable
+		LuaProfiler(const LuaProfiler&) = delete;
+		LuaProfiler& operator=(const LuaProfiler&) = delete;
+
+		bool isEnabled() const {
+			return enabled;
+		}
+
+		void start(uint32_t sampleInterval = 0);
+		void stop();
+		void reset();
+
+		// writes self wall time (microseconds) as flamegraph-compatible collapsed
+		// stacks to fileName and sampled stacks to fileName + ".samples"
+		bool dump(const std::string& fileName) const;
+		void printSummary(size_t limit = 20) const;
+
+		// must be paired, called from the dispatcher thread only
+		void enterCallback(const ScriptEnvironment* env);
+		void leaveCallback();
+
+		// (re)installs the sampling hook on a freshly created state
+		void attach(lua_State* L);
+
+	private:
+		struct ActiveCallback {
+			std::string label;
+			std::chrono::steady_clock::time_point startTime;
+			uint64_t childTime = 0; // microseconds spent in nested callbacks
+		};
+
+		static void sampleHook(lua_State* L, lua_Debug* ar);
+		void addSample(lua_State* L);
+
+		std::unordered_map<std::string, LuaProfilerCallStats> callStats;
+		std::unordered_map<std::string, uint64_t> samples;
+		std::vector<ActiveCallback> activeCallbacks;
+
+		std::chrono::steady_clock::time_point startTime;
+		uint32_t sampleInterval = 0;
+		bool enabled = false;
+};
+
+extern LuaProfiler g_luaProfiler;
+
+#endif
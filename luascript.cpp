@@ -3,6 +3,7 @@
 
 #include "otpch.h"
 
+#include <boost/filesystem.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <fmt/format.h>
 
@@ -26,6 +27,7 @@
 #include "globalevent.h"
 #include "script.h"
 #include "weapons.h"
+#include "luaprofiler.h"
 
 extern Chat* g_chat;
 extern Game g_game;
@@ -255,8 +257,43 @@ std::string LuaScriptInterface::getErrorDesc(ErrorCode_t code)
 ScriptEnvironment LuaScriptInterface::scriptEnv[16];
 int32_t LuaScriptInterface::scriptEnvIndex = -1;
 
+namespace {
+
+struct LuaMemoryAccount {
+	std::string name;
+	uint64_t allocated = 0;
+	uint64_t freed = 0;
+};
+
+// one account per interface name, the environment's comes first so blocks allocated before it is constructed have an owner
+std::vector<LuaMemoryAccount>& getMemoryAccounts()
+{
+	static std::vector<LuaMemoryAccount> memoryAccounts{{"Main Interface"}};
+	return memoryAccounts;
+}
+
+uint32_t getMemoryAccount(const std::string& name)
+{
+	auto& memoryAccounts = getMemoryAccounts();
+	for (size_t i = 0; i < memoryAccounts.size(); ++i) {
+		if (memoryAccounts[i].name == name) {
+			return i;
+		}
+	}
+
+	memoryAccounts.push_back({name});
+	return memoryAccounts.size() - 1;
+}
+
+// every block is preceded by the account that allocated it, padded to keep lua's alignment
+constexpr size_t MEMORY_HEADER_SIZE = alignof(std::max_align_t);
+static_assert(MEMORY_HEADER_SIZE >= sizeof(uint32_t), "memory header too small for the account");
+
+}
+
 LuaScriptInterface::LuaScriptInterface(std::string interfaceName) : interfaceName(std::move(interfaceName))
 {
+	memoryAccount = getMemoryAccount(this->interfaceName);
 	if (!g_luaEnvironment.getLuaState()) {
 		g_luaEnvironment.initState();
 	}
@@ -267,6 +304,49 @@ LuaScriptInterface::~LuaScriptInterface()
 	closeState();
 }
 
+void* LuaScriptInterface::luaAllocator(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+	// charge the interface whose script is running, or the environment itself
+	LuaScriptInterface* owner = nullptr;
+	if (scriptEnvIndex >= 0) {
+		owner = scriptEnv[scriptEnvIndex].getScriptInterface();
+	}
+	if (!owner) {
+		owner = static_cast<LuaScriptInterface*>(ud);
+	}
+
+	auto& memoryAccounts = getMemoryAccounts();
+
+	// the old size is credited to the account that allocated the block, whoever releases it
+	char* block = nullptr;
+	if (ptr) {
+		block = static_cast<char*>(ptr) - MEMORY_HEADER_SIZE;
+		uint32_t account;
+		memcpy(&account, block, sizeof(account));
+		memoryAccounts[account].freed += osize;
+	}
+
+	if (nsize == 0) {
+		free(block);
+		return nullptr;
+	}
+
+	char* newBlock = static_cast<char*>(realloc(block, nsize + MEMORY_HEADER_SIZE));
+	if (!newBlock) {
+		// lua keeps the old block when a reallocation fails
+		if (block) {
+			uint32_t account;
+			memcpy(&account, block, sizeof(account));
+			memoryAccounts[account].freed -= osize;
+		}
+		return nullptr;
+	}
+
+	memcpy(newBlock, &owner->memoryAccount, sizeof(owner->memoryAccount));
+	memoryAccounts[owner->memoryAccount].allocated += nsize;
+	return newBlock + MEMORY_HEADER_SIZE;
+}
+
 bool LuaScriptInterface::reInitState()
 {
 	g_luaEnvironment.clearCombatObjects(this);
@@ -289,6 +369,14 @@ int LuaScriptInterface::protectedCall(lua_State* L, int nargs, int nresults)
 }
 
 int32_t LuaScriptInterface::loadFile(const std::string& file, Npc* npc /* = nullptr*/)
+{
+	if (compileFile(file) != 0) {
+		return -1;
+	}
+	return runFile(file, npc);
+}
+
+int32_t LuaScriptInterface::compileFile(const std::string& file)
 {
 	//loads file as a chunk at stack top
 	int ret = luaL_loadfile(luaState, file.c_str());
@@ -302,11 +390,19 @@ int32_t LuaScriptInterface::loadFile(const std::string& file, Npc* npc /* = null
 		lua_pop(luaState, 1);
 		return -1;
 	}
+	return 0;
+}
 
+int32_t LuaScriptInterface::runFile(const std::string& file, Npc* npc)
+{
+	// events created after the file ran must not be tagged with it, a reload
+	// of the file would remove them
+	std::string previousFile = std::move(loadingFile);
 	loadingFile = file;
 
 	if (!reserveScriptEnv()) {
 		lua_pop(luaState, 1);
+		loadingFile = std::move(previousFile);
 		return -1;
 	}
 
@@ -315,14 +411,16 @@ int32_t LuaScriptInterface::loadFile(const std::string& file, Npc* npc /* = null
 	env->setNpc(npc);
 
 	//execute it
-	ret = protectedCall(luaState, 0, 0);
+	int ret = protectedCall(luaState, 0, 0);
 	if (ret != 0) {
 		reportError(nullptr, popString(luaState));
 		resetScriptEnv();
+		loadingFile = std::move(previousFile);
 		return -1;
 	}
 
 	resetScriptEnv();
+	loadingFile = std::move(previousFile);
 	return 0;
 }
 
@@ -528,6 +626,11 @@ int LuaScriptInterface::luaErrorHandler(lua_State* L)
 
 bool LuaScriptInterface::callFunction(int params)
 {
+	const bool profiling = g_luaProfiler.isEnabled();
+	if (profiling) {
+		g_luaProfiler.enterCallback(getScriptEnv());
+	}
+
 	bool result = false;
 	int size = lua_gettop(luaState);
 	if (protectedCall(luaState, params, 1) != 0) {
@@ -536,6 +639,10 @@ bool LuaScriptInterface::callFunction(int params)
 		result = LuaScriptInterface::getBoolean(luaState, -1);
 	}
 
+	if (profiling) {
+		g_luaProfiler.leaveCallback();
+	}
+
 	lua_pop(luaState, 1);
 	if ((lua_gettop(luaState) + params + 1) != size) {
 		LuaScriptInterface::reportError(nullptr, "Stack size changed!");
@@ -547,11 +654,20 @@ bool LuaScriptInterface::callFunction(int params)
 
 void LuaScriptInterface::callVoidFunction(int params)
 {
+	const bool profiling = g_luaProfiler.isEnabled();
+	if (profiling) {
+		g_luaProfiler.enterCallback(getScriptEnv());
+	}
+
 	int size = lua_gettop(luaState);
 	if (protectedCall(luaState, params, 0) != 0) {
 		LuaScriptInterface::reportError(nullptr, LuaScriptInterface::popString(luaState));
 	}
 
+	if (profiling) {
+		g_luaProfiler.leaveCallback();
+	}
+
 	if ((lua_gettop(luaState) + params + 1) != size) {
 		LuaScriptInterface::reportError(nullptr, "Stack size changed!");
 	}
@@ -1043,6 +1159,21 @@ void LuaScriptInterface::registerFunctions()
 	//stopEvent(eventid)
 	lua_register(luaState, "stopEvent", LuaScriptInterface::luaStopEvent);
 
+	//startCoroutine(callback, ...)
+	lua_register(luaState, "startCoroutine", LuaScriptInterface::luaStartCoroutine);
+
+	//stopCoroutine(coroutineId)
+	lua_register(luaState, "stopCoroutine", LuaScriptInterface::luaStopCoroutine);
+
+	//wait(delay, ...)
+	lua_register(luaState, "wait", LuaScriptInterface::luaWait);
+
+	//waitFor(eventName)
+	lua_register(luaState, "waitFor", LuaScriptInterface::luaWaitFor);
+
+	//notifyCoroutines(eventName, ...)
+	lua_register(luaState, "notifyCoroutines", LuaScriptInterface::luaNotifyCoroutines);
+
 	//saveServer()
 	lua_register(luaState, "saveServer", LuaScriptInterface::luaSaveServer);
 
@@ -2090,6 +2221,13 @@ void LuaScriptInterface::registerFunctions()
 	registerEnumIn("configKeys", ConfigManager::EXP_FROM_PLAYERS_LEVEL_RANGE)
 	registerEnumIn("configKeys", ConfigManager::MAX_PACKETS_PER_SECOND)
 	registerEnumIn("configKeys", ConfigManager::PLAYER_CONSOLE_LOGS)
+	registerEnumIn("configKeys", ConfigManager::MAP_SNAPSHOT)
+	registerEnumIn("configKeys", ConfigManager::MAX_LUA_COROUTINES)
+	registerEnumIn("configKeys", ConfigManager::SCRIPTS_WATCH_INTERVAL)
+	registerEnumIn("configKeys", ConfigManager::LUA_GC_PAUSE)
+	registerEnumIn("configKeys", ConfigManager::LUA_GC_STEPMUL)
+	registerEnumIn("configKeys", ConfigManager::LUA_GC_IDLE_STEP_SIZE)
+	registerEnumIn("configKeys", ConfigManager::MAX_QUEUED_SEND_BYTES)
 
 	// os
 	registerMethod("os", "mtime", LuaScriptInterface::luaSystemTime);
@@ -2137,6 +2275,20 @@ void LuaScriptInterface::registerFunctions()
 	registerMethod("Game", "getClientVersion", LuaScriptInterface::luaGameGetClientVersion);
 
 	registerMethod("Game", "reload", LuaScriptInterface::luaGameReload);
+	registerMethod("Game", "reloadScript", LuaScriptInterface::luaGameReloadScript);
+
+	registerMethod("Game", "getLuaMemoryStats", LuaScriptInterface::luaGameGetLuaMemoryStats);
+	registerMethod("Game", "getCustomAttributeKey", LuaScriptInterface::luaGameGetCustomAttributeKey);
+	registerMethod("Game", "getTileCacheStats", LuaScriptInterface::luaGameGetTileCacheStats);
+	registerMethod("Game", "getAllocationStats", LuaScriptInterface::luaGameGetAllocationStats);
+	registerMethod("Game", "getNpcStats", LuaScriptInterface::luaGameGetNpcStats);
+	registerMethod("Game", "getBroadcastStats", LuaScriptInterface::luaGameGetBroadcastStats);
+	registerMethod("Game", "getPacketStats", LuaScriptInterface::luaGameGetPacketStats);
+
+	registerMethod("Game", "startLuaProfiler", LuaScriptInterface::luaGameStartLuaProfiler);
+	registerMethod("Game", "stopLuaProfiler", LuaScriptInterface::luaGameStopLuaProfiler);
+	registerMethod("Game", "resetLuaProfiler", LuaScriptInterface::luaGameResetLuaProfiler);
+	registerMethod("Game", "dumpLuaProfiler", LuaScriptInterface::luaGameDumpLuaProfiler);
 
 	registerMethod("Game", "getAccountStorageValue", LuaScriptInterface::luaGameGetAccountStorageValue);
 	registerMethod("Game", "setAccountStorageValue", LuaScriptInterface::luaGameSetAccountStorageValue);
@@ -3880,6 +4032,170 @@ int LuaScriptInterface::luaStopEvent(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaStartCoroutine(lua_State* L)
+{
+	//startCoroutine(callback, ...)
+	if (!isFunction(L, 1)) {
+		reportErrorFunc(L, "callback parameter should be a function.");
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	auto& coroutines = g_luaEnvironment.coroutines;
+	if (coroutines.size() >= static_cast<size_t>(g_config.getNumber(ConfigManager::MAX_LUA_COROUTINES))) {
+		reportErrorFunc(L, fmt::format("Too many running coroutines: {:d}.", coroutines.size()));
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	int parameters = lua_gettop(L);
+
+	LuaCoroutineDesc coroutineDesc;
+	coroutineDesc.thread = lua_newthread(L);
+	coroutineDesc.scriptId = getScriptEnv()->getScriptId();
+
+	// move the callback and its arguments onto the new thread
+	lua_insert(L, 1);
+	lua_xmove(L, coroutineDesc.thread, parameters);
+	coroutineDesc.threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	uint32_t coroutineId = g_luaEnvironment.lastCoroutineId++;
+	g_luaEnvironment.coroutineIds[coroutineDesc.thread] = coroutineId;
+	coroutines.emplace(coroutineId, std::move(coroutineDesc));
+
+	g_luaEnvironment.resumeCoroutine(coroutineId, parameters - 1);
+	lua_pushnumber(L, coroutineId);
+	return 1;
+}
+
+int LuaScriptInterface::luaStopCoroutine(lua_State* L)
+{
+	//stopCoroutine(coroutineId)
+	uint32_t coroutineId = getNumber<uint32_t>(L, 1);
+
+	auto& coroutines = g_luaEnvironment.coroutines;
+	if (coroutines.find(coroutineId) == coroutines.end()) {
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	g_luaEnvironment.stopCoroutine(coroutineId);
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaWait(lua_State* L)
+{
+	//wait(delay, ...)
+	//creatures passed after the delay are returned once resumed, or nil if they are gone
+	//creatures held in locals are re-wrapped the same way, those in upvalues or tables must not be used after the yield
+	auto it = g_luaEnvironment.coroutineIds.find(L);
+	if (it == g_luaEnvironment.coroutineIds.end()) {
+		reportErrorFunc(L, "wait can only be called from a coroutine created by startCoroutine.");
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	if (!isNumber(L, 1)) {
+		reportErrorFunc(L, "delay parameter should be a number.");
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	uint32_t coroutineId = it->second;
+	LuaCoroutineDesc& coroutineDesc = g_luaEnvironment.coroutines[coroutineId];
+
+	int parameters = lua_gettop(L);
+	coroutineDesc.creatureIds.clear();
+	coroutineDesc.creatureIds.reserve(parameters - 1);
+	for (int i = 2; i <= parameters; ++i) {
+		Creature* creature = getCreature(L, i);
+		coroutineDesc.creatureIds.push_back(creature ? creature->getID() : 0);
+	}
+
+	uint32_t delay = std::max<uint32_t>(SCHEDULER_MINTICKS, getNumber<uint32_t>(L, 1));
+	coroutineDesc.eventId = g_scheduler.addEvent(createSchedulerTask(
+		delay, std::bind(&LuaEnvironment::executeCoroutine, &g_luaEnvironment, coroutineId)
+	));
+
+	lua_settop(L, 0);
+	LuaEnvironment::saveCreatureLocals(L, coroutineDesc);
+	return lua_yield(L, 0);
+}
+
+int LuaScriptInterface::luaWaitFor(lua_State* L)
+{
+	//waitFor(eventName, ...)
+	//returns the creatures passed after the event name, or nil if they are gone, followed by the arguments passed to notifyCoroutines
+	//creatures held in locals are re-wrapped the same way, those in upvalues or tables must not be used after the yield
+	auto it = g_luaEnvironment.coroutineIds.find(L);
+	if (it == g_luaEnvironment.coroutineIds.end()) {
+		reportErrorFunc(L, "waitFor can only be called from a coroutine created by startCoroutine.");
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	if (!isString(L, 1)) {
+		reportErrorFunc(L, "eventName parameter should be a string.");
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	uint32_t coroutineId = it->second;
+	LuaCoroutineDesc& coroutineDesc = g_luaEnvironment.coroutines[coroutineId];
+	int parameters = lua_gettop(L);
+	coroutineDesc.creatureIds.clear();
+	coroutineDesc.creatureIds.reserve(parameters - 1);
+	for (int i = 2; i <= parameters; ++i) {
+		Creature* creature = getCreature(L, i);
+		coroutineDesc.creatureIds.push_back(creature ? creature->getID() : 0);
+	}
+
+	coroutineDesc.waitEvent = getString(L, 1);
+	g_luaEnvironment.coroutineWaiters.emplace(coroutineDesc.waitEvent, coroutineId);
+
+	lua_settop(L, 0);
+	LuaEnvironment::saveCreatureLocals(L, coroutineDesc);
+	return lua_yield(L, 0);
+}
+
+int LuaScriptInterface::luaNotifyCoroutines(lua_State* L)
+{
+	//notifyCoroutines(eventName, ...)
+	const std::string& eventName = getString(L, 1);
+
+	auto& coroutineWaiters = g_luaEnvironment.coroutineWaiters;
+	auto range = coroutineWaiters.equal_range(eventName);
+
+	std::vector<uint32_t> waiters;
+	for (auto it = range.first; it != range.second; ++it) {
+		waiters.push_back(it->second);
+	}
+	coroutineWaiters.erase(range.first, range.second);
+
+	int parameters = lua_gettop(L);
+	for (uint32_t coroutineId : waiters) {
+		auto it = g_luaEnvironment.coroutines.find(coroutineId);
+		if (it == g_luaEnvironment.coroutines.end()) {
+			// stopped by an earlier waiter
+			continue;
+		}
+
+		LuaCoroutineDesc& coroutineDesc = it->second;
+		coroutineDesc.waitEvent.clear();
+
+		int nargs = g_luaEnvironment.pushWaitCreatures(coroutineDesc);
+		for (int i = 2; i <= parameters; ++i) {
+			lua_pushvalue(L, i);
+			lua_xmove(L, coroutineDesc.thread, 1);
+		}
+		g_luaEnvironment.resumeCoroutine(coroutineId, nargs + parameters - 1);
+	}
+
+	lua_pushnumber(L, waiters.size());
+	return 1;
+}
+
 int LuaScriptInterface::luaSaveServer(lua_State* L)
 {
 	g_game.saveGameState();
@@ -4740,6 +5056,7 @@ int LuaScriptInterface::luaGameCreateMonsterType(lua_State* L)
 		monsterType->info.lootItems.clear();
 		monsterType->info.attackSpells.clear();
 		monsterType->info.defenseSpells.clear();
+		monsterType->compileSpells();
 		monsterType->info.scripts.clear();
 		monsterType->info.thinkEvent = -1;
 		monsterType->info.creatureAppearEvent = -1;
@@ -4799,6 +5116,202 @@ int LuaScriptInterface::luaGameReload(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaGameReloadScript(lua_State* L)
+{
+	// Game.reloadScript(scriptFile)
+	if (!isString(L, 1)) {
+		reportErrorFunc(L, "scriptFile parameter should be a string.");
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	// scripts are loaded by absolute path, and the caller may be one of the events being replaced
+	std::string scriptFile = boost::filesystem::absolute(getString(L, 1)).string();
+	g_dispatcher.addTask(createTask([scriptFile]() {
+		g_scripts->reloadScript(scriptFile);
+	}));
+
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetCustomAttributeKey(lua_State* L)
+{
+	// Game.getCustomAttributeKey(name)
+	ItemAttributes::CustomAttributeKey key = ItemAttributes::getCustomAttributeKey(getString(L, 1));
+	lua_pushlightuserdata(L, reinterpret_cast<void*>(static_cast<uintptr_t>(key)));
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetTileCacheStats(lua_State* L)
+{
+	// Game.getTileCacheStats()
+	const TileItemsCacheStats& stats = ProtocolGame::getTileCacheStats();
+	lua_createtable(L, 0, 5);
+	setField(L, "hits", stats.hits);
+	setField(L, "misses", stats.misses);
+	setField(L, "bytesServed", stats.bytesServed);
+	setField(L, "evictions", stats.evictions);
+	setField(L, "cached", Tile::getItemsCacheCount());
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetAllocationStats(lua_State* L)
+{
+	// Game.getAllocationStats()
+	lua_newtable(L);
+
+	int index = 0;
+	for (const ObjectPool* pool : {&ObjectPool::getItemPool(), &ObjectPool::getTilePool()}) {
+		for (const auto& stats : pool->getStats()) {
+			lua_createtable(L, 0, 5);
+			setField(L, "pool", pool->getName());
+			setField(L, "types", pool->getTypeNames(stats.objectSize));
+			setField(L, "objectSize", stats.objectSize);
+			setField(L, "live", stats.live);
+			setField(L, "capacity", stats.capacity);
+			lua_rawseti(L, -2, ++index);
+		}
+	}
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetNpcStats(lua_State* L)
+{
+	// Game.getNpcStats()
+	uint32_t dormant = 0;
+	const auto& npcs = g_game.getNpcs();
+	for (const auto& it : npcs) {
+		if (it.second->isDormant()) {
+			++dormant;
+		}
+	}
+
+	lua_createtable(L, 0, 2);
+	setField(L, "active", npcs.size() - dormant);
+	setField(L, "dormant", dormant);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetBroadcastStats(lua_State* L)
+{
+	// Game.getBroadcastStats()
+	static const std::array<std::pair<BroadcastType_t, const char*>, BROADCAST_LAST + 1> broadcastNames = {{
+		{BROADCAST_CREATURESAY, "creatureSay"},
+		{BROADCAST_DISTANCEEFFECT, "distanceEffect"},
+		{BROADCAST_MAGICEFFECT, "magicEffect"},
+	}};
+
+	lua_createtable(L, 0, broadcastNames.size());
+	for (const auto& it : broadcastNames) {
+		const BroadcastStats& stats = ProtocolGame::getBroadcastStats(it.first);
+		lua_createtable(L, 0, 3);
+		setField(L, "sent", stats.sent);
+		setField(L, "suppressed", stats.suppressed);
+		setField(L, "bytesSaved", stats.bytesSaved);
+		lua_setfield(L, -2, it.second);
+	}
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetPacketStats(lua_State* L)
+{
+	// Game.getPacketStats()
+	static const std::array<std::pair<PacketClass_t, const char*>, PACKET_CLASS_LAST + 1> packetClassNames = {{
+		{PACKET_CRITICAL, "critical"},
+		{PACKET_MOVEMENT, "movement"},
+		{PACKET_COSMETIC, "cosmetic"},
+	}};
+
+	const uint32_t budget = g_config.getNumber(ConfigManager::MAX_QUEUED_SEND_BYTES);
+	uint64_t queuedBytes = 0;
+	uint32_t maxQueuedBytes = 0, overBudget = 0;
+	for (const auto& it : g_game.getPlayers()) {
+		uint32_t backlog = it.second->getSendBacklog();
+		queuedBytes += backlog;
+		maxQueuedBytes = std::max(maxQueuedBytes, backlog);
+		if (budget != 0 && backlog > budget) {
+			++overBudget;
+		}
+	}
+
+	lua_createtable(L, 0, packetClassNames.size() + 3);
+	for (const auto& it : packetClassNames) {
+		const PacketClassStats& stats = ProtocolGame::getPacketStats(it.first);
+		lua_createtable(L, 0, 4);
+		setField(L, "packets", stats.packets);
+		setField(L, "bytes", stats.bytes);
+		setField(L, "droppedPackets", stats.droppedPackets);
+		setField(L, "droppedBytes", stats.droppedBytes);
+		lua_setfield(L, -2, it.second);
+	}
+	setField(L, "queuedBytes", queuedBytes);
+	setField(L, "maxQueuedBytes", maxQueuedBytes);
+	setField(L, "overBudget", overBudget);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetLuaMemoryStats(lua_State* L)
+{
+	// Game.getLuaMemoryStats()
+	const LuaGarbageCollectorStats& gcStats = g_luaEnvironment.getGarbageCollectorStats();
+	lua_createtable(L, 0, 6);
+	setField(L, "heapSize", g_luaEnvironment.getHeapSize());
+	setField(L, "gcSteps", gcStats.steps);
+	setField(L, "gcCycles", gcStats.cycles);
+	setField(L, "gcTotalPause", gcStats.totalPause);
+	setField(L, "gcMaxPause", gcStats.maxPause);
+
+	const auto& memoryAccounts = getMemoryAccounts();
+	lua_createtable(L, 0, memoryAccounts.size());
+	for (const auto& memoryAccount : memoryAccounts) {
+		lua_createtable(L, 0, 3);
+		setField(L, "allocated", memoryAccount.allocated);
+		setField(L, "freed", memoryAccount.freed);
+		setField(L, "live", memoryAccount.allocated - memoryAccount.freed);
+		lua_setfield(L, -2, memoryAccount.name.c_str());
+	}
+	lua_setfield(L, -2, "interfaces");
+	return 1;
+}
+
+int LuaScriptInterface::luaGameStartLuaProfiler(lua_State* L)
+{
+	// Game.startLuaProfiler([sampleInterval = 0])
+	g_luaProfiler.start(getNumber<uint32_t>(L, 1, 0));
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameStopLuaProfiler(lua_State* L)
+{
+	// Game.stopLuaProfiler()
+	g_luaProfiler.stop();
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameResetLuaProfiler(lua_State* L)
+{
+	// Game.resetLuaProfiler()
+	g_luaProfiler.reset();
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameDumpLuaProfiler(lua_State* L)
+{
+	// Game.dumpLuaProfiler([fileName])
+	std::string fileName = LUA_PROFILER_DUMP_FILE;
+	if (isString(L, 1)) {
+		fileName = getString(L, 1);
+	}
+
+	g_luaProfiler.printSummary();
+	pushBoolean(L, g_luaProfiler.dump(fileName));
+	return 1;
+}
+
 int LuaScriptInterface::luaGameGetAccountStorageValue(lua_State* L)
 {
 	// Game.getAccountStorageValue(accountId, key)
@@ -6714,6 +7227,38 @@ int LuaScriptInterface::luaItemRemoveAttribute(lua_State* L)
 	return 1;
 }
 
+namespace {
+
+// accepts a key from Game.getCustomAttributeKey, a string or a number
+bool getCustomAttributeKey(lua_State* L, int32_t arg, ItemAttributes::CustomAttributeKey& key, bool create)
+{
+	if (lua_islightuserdata(L, arg)) {
+		uint32_t id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(lua_touserdata(L, arg)));
+		if (!ItemAttributes::isCustomAttributeKey(id)) {
+			return false;
+		}
+		key = static_cast<ItemAttributes::CustomAttributeKey>(id);
+		return true;
+	}
+
+	std::string name;
+	if (LuaScriptInterface::isNumber(L, arg)) {
+		name = std::to_string(LuaScriptInterface::getNumber<int64_t>(L, arg));
+	} else if (LuaScriptInterface::isString(L, arg)) {
+		name = LuaScriptInterface::getString(L, arg);
+	} else {
+		return false;
+	}
+
+	if (create) {
+		key = ItemAttributes::getCustomAttributeKey(name);
+		return true;
+	}
+	return ItemAttributes::findCustomAttributeKey(name, key);
+}
+
+}
+
 int LuaScriptInterface::luaItemGetCustomAttribute(lua_State* L) {
 	// item:getCustomAttribute(key)
 	Item* item = getUserdata<Item>(L, 1);
@@ -6722,16 +7267,13 @@ int LuaScriptInterface::luaItemGetCustomAttribute(lua_State* L) {
 		return 1;
 	}
 
-	const ItemAttributes::CustomAttribute* attr;
-	if (isNumber(L, 2)) {
-		attr = item->getCustomAttribute(getNumber<int64_t>(L, 2));
-	} else if (isString(L, 2)) {
-		attr = item->getCustomAttribute(getString(L, 2));
-	} else {
+	ItemAttributes::CustomAttributeKey key;
+	if (!getCustomAttributeKey(L, 2, key, false)) {
 		lua_pushnil(L);
 		return 1;
 	}
 
+	const ItemAttributes::CustomAttribute* attr = item->getCustomAttribute(key);
 	if (attr) {
 		attr->pushToLua(L);
 	} else {
@@ -6748,12 +7290,8 @@ int LuaScriptInterface::luaItemSetCustomAttribute(lua_State* L) {
 		return 1;
 	}
 
-	std::string key;
-	if (isNumber(L, 2)) {
-		key = std::to_string(getNumber<int64_t>(L, 2));
-	} else if (isString(L, 2)) {
-		key = getString(L, 2);
-	} else {
+	ItemAttributes::CustomAttributeKey key;
+	if (!getCustomAttributeKey(L, 2, key, true)) {
 		lua_pushnil(L);
 		return 1;
 	}
@@ -6788,10 +7326,9 @@ int LuaScriptInterface::luaItemRemoveCustomAttribute(lua_State* L) {
 		return 1;
 	}
 
-	if (isNumber(L, 2)) {
-		pushBoolean(L, item->removeCustomAttribute(getNumber<int64_t>(L, 2)));
-	} else if (isString(L, 2)) {
-		pushBoolean(L, item->removeCustomAttribute(getString(L, 2)));
+	ItemAttributes::CustomAttributeKey key;
+	if (isNumber(L, 2) || isString(L, 2) || lua_islightuserdata(L, 2)) {
+		pushBoolean(L, getCustomAttributeKey(L, 2, key, false) && item->removeCustomAttribute(key));
 	} else {
 		lua_pushnil(L);
 	}
@@ -14311,6 +14848,7 @@ int LuaScriptInterface::luaMonsterTypeAddAttack(lua_State* L)
 			spellBlock_t sb;
 			if (g_monsters.deserializeSpell(spell, sb, monsterType->name)) {
 				monsterType->info.attackSpells.push_back(std::move(sb));
+				monsterType->compileSpells();
 			} else {
 				std::cout << monsterType->name << std::endl;
 				std::cout << "[Warning - Monsters::loadMonster] Cant load spell. " << spell->name << std::endl;
@@ -15582,6 +16120,7 @@ int LuaScriptInterface::luaSpellCreate(lua_State* L)
 	if (spellType == SPELL_INSTANT) {
 		InstantSpell* spell = new InstantSpell(getScriptEnv()->getScriptInterface());
 		spell->fromLua = true;
+		spell->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<Spell>(L, spell);
 		setMetatable(L, -1, "Spell");
 		spell->spellType = SPELL_INSTANT;
@@ -15589,6 +16128,7 @@ int LuaScriptInterface::luaSpellCreate(lua_State* L)
 	} else if (spellType == SPELL_RUNE) {
 		RuneSpell* spell = new RuneSpell(getScriptEnv()->getScriptInterface());
 		spell->fromLua = true;
+		spell->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<Spell>(L, spell);
 		setMetatable(L, -1, "Spell");
 		spell->spellType = SPELL_RUNE;
@@ -16420,6 +16960,7 @@ int LuaScriptInterface::luaCreateAction(lua_State* L)
 	Action* action = new Action(getScriptEnv()->getScriptInterface());
 	if (action) {
 		action->fromLua = true;
+		action->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<Action>(L, action);
 		setMetatable(L, -1, "Action");
 	} else {
@@ -16578,6 +17119,7 @@ int LuaScriptInterface::luaCreateTalkaction(lua_State* L)
 			talk->setWords(getString(L, i));
 		}
 		talk->fromLua = true;
+		talk->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<TalkAction>(L, talk);
 		setMetatable(L, -1, "TalkAction");
 	} else {
@@ -16670,6 +17212,7 @@ int LuaScriptInterface::luaCreateCreatureEvent(lua_State* L)
 	if (creature) {
 		creature->setName(getString(L, 2));
 		creature->fromLua = true;
+		creature->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<CreatureEvent>(L, creature);
 		setMetatable(L, -1, "CreatureEvent");
 	} else {
@@ -16765,6 +17308,7 @@ int LuaScriptInterface::luaCreateMoveEvent(lua_State* L)
 	MoveEvent* moveevent = new MoveEvent(getScriptEnv()->getScriptInterface());
 	if (moveevent) {
 		moveevent->fromLua = true;
+		moveevent->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<MoveEvent>(L, moveevent);
 		setMetatable(L, -1, "MoveEvent");
 	} else {
@@ -17089,6 +17633,7 @@ int LuaScriptInterface::luaCreateGlobalEvent(lua_State* L)
 		global->setName(getString(L, 2));
 		global->setEventType(GLOBALEVENT_NONE);
 		global->fromLua = true;
+		global->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 		pushUserdata<GlobalEvent>(L, global);
 		setMetatable(L, -1, "GlobalEvent");
 	} else {
@@ -17252,6 +17797,7 @@ int LuaScriptInterface::luaCreateWeapon(lua_State* L)
 				setMetatable(L, -1, "Weapon");
 				weapon->weaponType = type;
 				weapon->fromLua = true;
+				weapon->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 			} else {
 				lua_pushnil(L);
 			}
@@ -17265,6 +17811,7 @@ int LuaScriptInterface::luaCreateWeapon(lua_State* L)
 				setMetatable(L, -1, "Weapon");
 				weapon->weaponType = type;
 				weapon->fromLua = true;
+				weapon->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 			} else {
 				lua_pushnil(L);
 			}
@@ -17277,6 +17824,7 @@ int LuaScriptInterface::luaCreateWeapon(lua_State* L)
 				setMetatable(L, -1, "Weapon");
 				weapon->weaponType = type;
 				weapon->fromLua = true;
+				weapon->scriptFile = getScriptEnv()->getScriptInterface()->getLoadingFile();
 			} else {
 				lua_pushnil(L);
 			}
@@ -17878,13 +18426,19 @@ LuaEnvironment::~LuaEnvironment()
 
 bool LuaEnvironment::initState()
 {
-	luaState = luaL_newstate();
+	luaState = lua_newstate(luaAllocator, this);
 	if (!luaState) {
-		return false;
+		// 64 bit LuaJIT without GC64 refuses custom allocators
+		luaState = luaL_newstate();
+		if (!luaState) {
+			return false;
+		}
 	}
 
 	luaL_openlibs(luaState);
 	registerFunctions();
+	g_luaProfiler.attach(luaState);
+	setGarbageCollectorParameters();
 
 	runningEventId = EVENT_ID_USER;
 	return true;
@@ -17919,9 +18473,19 @@ bool LuaEnvironment::closeState()
 		luaL_unref(luaState, LUA_REGISTRYINDEX, timerEventDesc.function);
 	}
 
+	for (auto& coroutineEntry : coroutines) {
+		if (coroutineEntry.second.eventId != 0) {
+			g_scheduler.stopEvent(coroutineEntry.second.eventId);
+		}
+		luaL_unref(luaState, LUA_REGISTRYINDEX, coroutineEntry.second.threadRef);
+	}
+
 	combatIdMap.clear();
 	areaIdMap.clear();
 	timerEvents.clear();
+	coroutines.clear();
+	coroutineIds.clear();
+	coroutineWaiters.clear();
 	cacheFiles.clear();
 
 	lua_close(luaState);
@@ -18038,3 +18602,231 @@ void LuaEnvironment::executeTimerEvent(uint32_t eventIndex)
 		luaL_unref(luaState, LUA_REGISTRYINDEX, parameter);
 	}
 }
+
+void LuaEnvironment::executeCoroutine(uint32_t coroutineId)
+{
+	auto it = coroutines.find(coroutineId);
+	if (it == coroutines.end()) {
+		return;
+	}
+
+	LuaCoroutineDesc& coroutineDesc = it->second;
+	coroutineDesc.eventId = 0;
+	resumeCoroutine(coroutineId, pushWaitCreatures(coroutineDesc));
+}
+
+int LuaEnvironment::pushWaitCreatures(LuaCoroutineDesc& coroutineDesc)
+{
+	lua_State* thread = coroutineDesc.thread;
+	for (uint32_t creatureId : coroutineDesc.creatureIds) {
+		Creature* creature = g_game.getCreatureByID(creatureId);
+		if (creature) {
+			pushUserdata<Creature>(thread, creature);
+			setCreatureMetatable(thread, -1, creature);
+		} else {
+			lua_pushnil(thread);
+		}
+	}
+
+	int nargs = coroutineDesc.creatureIds.size();
+	coroutineDesc.creatureIds.clear();
+	return nargs;
+}
+
+void LuaEnvironment::saveCreatureLocals(lua_State* L, LuaCoroutineDesc& coroutineDesc)
+{
+	coroutineDesc.creatureLocals.clear();
+
+	// level 0 is wait/waitFor itself, temporaries are skipped
+	lua_Debug ar;
+	for (int level = 1; lua_getstack(L, level, &ar) != 0; ++level) {
+		const char* name;
+		for (int index = 1; (name = lua_getlocal(L, &ar, index)) != nullptr; ++index) {
+			if (name[0] != '(' && lua_isuserdata(L, -1)) {
+				LuaDataType type = getUserdataType(L, -1);
+				if (type == LuaData_Player || type == LuaData_Monster || type == LuaData_Npc) {
+					Creature* creature = getUserdata<Creature>(L, -1);
+					if (creature) {
+						coroutineDesc.creatureLocals.push_back({level, index, lua_touserdata(L, -1), creature->getID()});
+					}
+				}
+			}
+			lua_pop(L, 1);
+		}
+	}
+}
+
+void LuaEnvironment::restoreCreatureLocals(LuaCoroutineDesc& coroutineDesc)
+{
+	lua_State* thread = coroutineDesc.thread;
+
+	lua_Debug ar;
+	for (const auto& creatureLocal : coroutineDesc.creatureLocals) {
+		if (lua_getstack(thread, creatureLocal.level, &ar) == 0 || !lua_getlocal(thread, &ar, creatureLocal.index)) {
+			continue;
+		}
+
+		// the pointer inside may be dangling, only the userdata block itself is compared
+		bool unchanged = lua_touserdata(thread, -1) == creatureLocal.userdata;
+		lua_pop(thread, 1);
+		if (!unchanged) {
+			continue;
+		}
+
+		Creature* creature = g_game.getCreatureByID(creatureLocal.creatureId);
+		if (creature) {
+			pushUserdata<Creature>(thread, creature);
+			setCreatureMetatable(thread, -1, creature);
+		} else {
+			lua_pushnil(thread);
+		}
+		lua_setlocal(thread, &ar, creatureLocal.index);
+	}
+	coroutineDesc.creatureLocals.clear();
+}
+
+void LuaEnvironment::resumeCoroutine(uint32_t coroutineId, int nargs)
+{
+	auto it = coroutines.find(coroutineId);
+	if (it == coroutines.end()) {
+		return;
+	}
+
+	if (!reserveScriptEnv()) {
+		std::cout << "[Error - LuaScriptInterface::resumeCoroutine] Call stack overflow" << std::endl;
+		stopCoroutine(coroutineId);
+		return;
+	}
+
+	ScriptEnvironment* env = getScriptEnv();
+	env->setTimerEvent();
+	env->setScriptId(it->second.scriptId, this);
+
+	restoreCreatureLocals(it->second);
+
+	lua_State* thread = it->second.thread;
+	it->second.running = true;
+#if LUA_VERSION_NUM >= 504
+	int nresults;
+	int ret = lua_resume(thread, nullptr, nargs, &nresults);
+#elif LUA_VERSION_NUM >= 502
+	int ret = lua_resume(thread, nullptr, nargs);
+#else
+	int ret = lua_resume(thread, nargs);
+#endif
+
+	// stopCoroutine defers the release of a running coroutine until it is back here
+	it = coroutines.find(coroutineId);
+	if (it == coroutines.end()) {
+		resetScriptEnv();
+		return;
+	}
+
+	LuaCoroutineDesc& coroutineDesc = it->second;
+	coroutineDesc.running = false;
+
+	if (ret != 0 && ret != LUA_YIELD) {
+		reportError(nullptr, popString(thread));
+	} else if (ret == LUA_YIELD && !coroutineDesc.stopped && !coroutineDesc.isWaiting()) {
+		reportError(nullptr, "Coroutine yielded outside of wait or waitFor");
+	}
+
+	if (ret != LUA_YIELD || coroutineDesc.stopped || !coroutineDesc.isWaiting()) {
+		stopCoroutine(coroutineId);
+	}
+
+	resetScriptEnv();
+}
+
+void LuaEnvironment::stopCoroutine(uint32_t coroutineId)
+{
+	auto it = coroutines.find(coroutineId);
+	if (it == coroutines.end()) {
+		return;
+	}
+
+	LuaCoroutineDesc& coroutineDesc = it->second;
+	if (coroutineDesc.eventId != 0) {
+		g_scheduler.stopEvent(coroutineDesc.eventId);
+		coroutineDesc.eventId = 0;
+	}
+
+	if (!coroutineDesc.waitEvent.empty()) {
+		auto range = coroutineWaiters.equal_range(coroutineDesc.waitEvent);
+		for (auto waiter = range.first; waiter != range.second; ++waiter) {
+			if (waiter->second == coroutineId) {
+				coroutineWaiters.erase(waiter);
+				break;
+			}
+		}
+		coroutineDesc.waitEvent.clear();
+	}
+
+	if (coroutineDesc.running) {
+		// the thread is still executing, it must stay referenced until it yields
+		coroutineDesc.stopped = true;
+		return;
+	}
+
+	luaL_unref(luaState, LUA_REGISTRYINDEX, coroutineDesc.threadRef);
+	coroutineIds.erase(coroutineDesc.thread);
+	coroutines.erase(it);
+}
+
+void LuaEnvironment::setGarbageCollectorParameters()
+{
+	if (!luaState) {
+		return;
+	}
+
+	// zero means the config was not loaded yet, keep lua's defaults
+	int32_t pause = g_config.getNumber(ConfigManager::LUA_GC_PAUSE);
+	if (pause > 0) {
+		lua_gc(luaState, LUA_GCSETPAUSE, pause);
+	}
+
+	int32_t stepMul = g_config.getNumber(ConfigManager::LUA_GC_STEPMUL);
+	if (stepMul > 0) {
+		lua_gc(luaState, LUA_GCSETSTEPMUL, stepMul);
+	}
+}
+
+size_t LuaEnvironment::getHeapSize() const
+{
+	if (!luaState) {
+		return 0;
+	}
+	return (static_cast<size_t>(lua_gc(luaState, LUA_GCCOUNT, 0)) << 10) + lua_gc(luaState, LUA_GCCOUNTB, 0);
+}
+
+bool LuaEnvironment::collectGarbageStep()
+{
+	int32_t stepSize = g_config.getNumber(ConfigManager::LUA_GC_IDLE_STEP_SIZE);
+	if (!luaState || stepSize <= 0) {
+		return false;
+	}
+
+	// start an idle cycle once the heap grew by half of what would trigger an automatic one
+	if (!gcCycleRunning) {
+		int32_t pause = g_config.getNumber(ConfigManager::LUA_GC_PAUSE);
+		if (getHeapSize() * 200 < gcCycleHeapSize * (100 + pause)) {
+			return false;
+		}
+		gcCycleRunning = true;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	bool finished = lua_gc(luaState, LUA_GCSTEP, stepSize) != 0;
+	uint64_t pause = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	++gcStats.steps;
+	gcStats.totalPause += pause;
+	gcStats.maxPause = std::max(gcStats.maxPause, pause);
+
+	if (finished) {
+		++gcStats.cycles;
+		gcCycleRunning = false;
+		gcCycleHeapSize = getHeapSize();
+	}
+	return gcCycleRunning;
+}
@@ -82,6 +82,42 @@ struct LuaTimerEventDesc {
 	LuaTimerEventDesc(LuaTimerEventDesc&& other) = default;
 };
 
+struct LuaGarbageCollectorStats {
+	uint64_t steps = 0;
+	uint64_t cycles = 0;
+	uint64_t totalPause = 0; // microseconds
+	uint64_t maxPause = 0; // microseconds
+};
+
+struct LuaCoroutineDesc {
+	lua_State* thread = nullptr;
+	int32_t threadRef = -1;
+	int32_t scriptId = -1;
+
+	// what the coroutine is suspended on, see wait/waitFor
+	uint32_t eventId = 0;
+	std::string waitEvent;
+
+	// creatures handed to wait()/waitFor(), re-resolved by id on resume
+	std::vector<uint32_t> creatureIds;
+
+	// creature userdata held in locals at the yield, re-wrapped by id on resume
+	struct CreatureLocal {
+		int level;
+		int index;
+		void* userdata;
+		uint32_t creatureId;
+	};
+	std::vector<CreatureLocal> creatureLocals;
+
+	bool running = false;
+	bool stopped = false;
+
+	bool isWaiting() const {
+		return eventId != 0 || !waitEvent.empty();
+	}
+};
+
 class LuaScriptInterface;
 class Cylinder;
 class Game;
@@ -227,6 +263,9 @@ class LuaScriptInterface
 		const std::string& getLastLuaError() const {
 			return lastLuaError;
 		}
+		const std::string& getLoadingFile() const {
+			return loadingFile;
+		}
 
 		lua_State* getLuaState() const {
 			return luaState;
@@ -435,8 +474,18 @@ class LuaScriptInterface
 
 		static std::string getErrorDesc(ErrorCode_t code);
 
+		static void* luaAllocator(void* ud, void* ptr, size_t osize, size_t nsize);
+
+		// runs the chunk of file at the stack top, pops it
+		int32_t runFile(const std::string& file, Npc* npc);
+		// loads file as a chunk at the stack top
+		int32_t compileFile(const std::string& file);
+
 		lua_State* luaState = nullptr;
 
+		// memory account charged for blocks allocated while this interface is running
+		uint32_t memoryAccount = 0;
+
 		int32_t eventTableRef = -1;
 		int32_t runningEventId = EVENT_ID_USER;
 
@@ -491,6 +540,12 @@ class LuaScriptInterface
 		static int luaAddEvent(lua_State* L);
 		static int luaStopEvent(lua_State* L);
 
+		static int luaStartCoroutine(lua_State* L);
+		static int luaStopCoroutine(lua_State* L);
+		static int luaWait(lua_State* L);
+		static int luaWaitFor(lua_State* L);
+		static int luaNotifyCoroutines(lua_State* L);
+
 		static int luaSaveServer(lua_State* L);
 		static int luaCleanMap(lua_State* L);
 
@@ -582,6 +637,20 @@ class LuaScriptInterface
 		static int luaGameGetClientVersion(lua_State* L);
 
 		static int luaGameReload(lua_State* L);
+		static int luaGameReloadScript(lua_State* L);
+
+		static int luaGameGetLuaMemoryStats(lua_State* L);
+		static int luaGameGetCustomAttributeKey(lua_State* L);
+		static int luaGameGetTileCacheStats(lua_State* L);
+		static int luaGameGetAllocationStats(lua_State* L);
+		static int luaGameGetNpcStats(lua_State* L);
+		static int luaGameGetBroadcastStats(lua_State* L);
+		static int luaGameGetPacketStats(lua_State* L);
+
+		static int luaGameStartLuaProfiler(lua_State* L);
+		static int luaGameStopLuaProfiler(lua_State* L);
+		static int luaGameResetLuaProfiler(lua_State* L);
+		static int luaGameDumpLuaProfiler(lua_State* L);
 
 		static int luaGameGetAccountStorageValue(lua_State* L);
 		static int luaGameSetAccountStorageValue(lua_State* L);
@@ -1621,10 +1690,32 @@ class LuaEnvironment : public LuaScriptInterface
 		uint32_t createAreaObject(LuaScriptInterface* interface);
 		void clearAreaObjects(LuaScriptInterface* interface);
 
+		size_t getCoroutineCount() const {
+			return coroutines.size();
+		}
+
+		// incremental gc work done from the dispatcher's idle time, returns true while a cycle is unfinished
+		bool collectGarbageStep();
+		void setGarbageCollectorParameters();
+		size_t getHeapSize() const;
+		const LuaGarbageCollectorStats& getGarbageCollectorStats() const {
+			return gcStats;
+		}
+
 	private:
 		void executeTimerEvent(uint32_t eventIndex);
 
+		void executeCoroutine(uint32_t coroutineId);
+		void resumeCoroutine(uint32_t coroutineId, int nargs);
+		int pushWaitCreatures(LuaCoroutineDesc& coroutineDesc);
+		static void saveCreatureLocals(lua_State* L, LuaCoroutineDesc& coroutineDesc);
+		void restoreCreatureLocals(LuaCoroutineDesc& coroutineDesc);
+		void stopCoroutine(uint32_t coroutineId);
+
 		std::unordered_map<uint32_t, LuaTimerEventDesc> timerEvents;
+		std::unordered_map<uint32_t, LuaCoroutineDesc> coroutines;
+		std::unordered_map<lua_State*, uint32_t> coroutineIds;
+		std::multimap<std::string, uint32_t> coroutineWaiters;
 		std::unordered_map<uint32_t, Combat_ptr> combatMap;
 		std::unordered_map<uint32_t, AreaCombat*> areaMap;
 
@@ -1633,7 +1724,12 @@ class LuaEnvironment : public LuaScriptInterface
 
 		LuaScriptInterface* testInterface = nullptr;
 
+		LuaGarbageCollectorStats gcStats;
+		size_t gcCycleHeapSize = 0;
+		bool gcCycleRunning = false;
+
 		uint32_t lastEventTimerId = 1;
+		uint32_t lastCoroutineId = 1;
 		uint32_t lastCombatId = 0;
 		uint32_t lastAreaId = 0;
 
@@ -5,6 +5,8 @@
 
 #include "mailbox.h"
 #include "game.h"
+#include "inbox.h"
+#include "iodelivery.h"
 #include "iologindata.h"
 
 extern Game g_game;
@@ -93,17 +95,25 @@ bool Mailbox::sendItem(Item* item) const
 			return true;
 		}
 	} else {
-		Player tmpPlayer(nullptr);
-		if (!IOLoginData::loadPlayerByName(&tmpPlayer, receiver)) {
+		uint32_t guid = IOLoginData::getGuidByName(receiver);
+		if (guid == 0) {
 			return false;
 		}
 
-		if (g_game.internalMoveItem(item->getParent(), tmpPlayer.getInbox(), INDEX_WHEREEVER,
+		// stamped in a detached inbox, then written to the receiver's inbox without loading them
+		Inbox* inbox = new Inbox(ITEM_INBOX);
+		inbox->incrementReferenceCounter();
+
+		bool sent = false;
+		if (g_game.internalMoveItem(item->getParent(), inbox, INDEX_WHEREEVER,
 		                            item, item->getItemCount(), nullptr, FLAG_NOLIMIT) == RETURNVALUE_NOERROR) {
 			g_game.transformItem(item, item->getID() + 1);
-			IOLoginData::savePlayer(&tmpPlayer);
-			return true;
+			IODelivery::deliverItems(guid, ItemList(inbox->getItemList().begin(), inbox->getItemList().end()));
+			sent = true;
 		}
+
+		inbox->decrementReferenceCounter();
+		return sent;
 	}
 	return false;
 }
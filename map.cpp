@@ -5,6 +5,7 @@
 
 #include "iomap.h"
 #include "iomapserialize.h"
+#include "iomapsnapshot.h"
 #include "combat.h"
 #include "creature.h"
 #include "game.h"
@@ -14,10 +15,18 @@ extern Game g_game;
 
 bool Map::loadMap(const std::string& identifier, bool loadHouses)
 {
-	IOMap loader;
-	if (!loader.loadMap(this, identifier)) {
-		std::cout << "[Fatal - Map::loadMap] " << loader.getLastErrorString() << std::endl;
-		return false;
+	// snapshots only cover the main map
+	bool useSnapshot = loadHouses && g_config.getBoolean(ConfigManager::MAP_SNAPSHOT);
+	if (!useSnapshot || !IOMapSnapshot::load(*this, identifier)) {
+		IOMap loader;
+		if (!loader.loadMap(this, identifier)) {
+			std::cout << "[Fatal - Map::loadMap] " << loader.getLastErrorString() << std::endl;
+			return false;
+		}
+
+		if (useSnapshot) {
+			IOMapSnapshot::save(*this, identifier);
+		}
 	}
 
 	if (!IOMap::loadSpawns(this)) {
@@ -473,6 +482,59 @@ void Map::getSpectators(SpectatorVec& spectators, const Position& centerPos, boo
 	}
 }
 
+bool Map::isPlayerNearby(const Position& centerPos) const
+{
+	if (centerPos.z >= MAP_MAX_LAYERS) {
+		return false;
+	}
+
+	int32_t min_x = centerPos.x - maxViewportX;
+	int32_t max_x = centerPos.x + maxViewportX;
+	int32_t min_y = centerPos.y - maxViewportY;
+	int32_t max_y = centerPos.y + maxViewportY;
+
+	uint16_t x1 = std::min<uint32_t>(0xFFFF, std::max<int32_t>(0, min_x));
+	uint16_t y1 = std::min<uint32_t>(0xFFFF, std::max<int32_t>(0, min_y));
+	uint16_t x2 = std::min<uint32_t>(0xFFFF, std::max<int32_t>(0, max_x));
+	uint16_t y2 = std::min<uint32_t>(0xFFFF, std::max<int32_t>(0, max_y));
+
+	int32_t startx1 = x1 - (x1 % FLOOR_SIZE);
+	int32_t starty1 = y1 - (y1 % FLOOR_SIZE);
+	int32_t endx2 = x2 - (x2 % FLOOR_SIZE);
+	int32_t endy2 = y2 - (y2 % FLOOR_SIZE);
+
+	const QTreeLeafNode* leafS = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, startx1, starty1);
+	const QTreeLeafNode* leafE;
+
+	for (int_fast32_t ny = starty1; ny <= endy2; ny += FLOOR_SIZE) {
+		leafE = leafS;
+		for (int_fast32_t nx = startx1; nx <= endx2; nx += FLOOR_SIZE) {
+			if (leafE) {
+				for (Creature* creature : leafE->player_list) {
+					const Position& cpos = creature->getPosition();
+					if (cpos.z != centerPos.z || min_x > cpos.x || max_x < cpos.x || min_y > cpos.y || max_y < cpos.y) {
+						continue;
+					}
+
+					if (!creature->getPlayer()->hasFlag(PlayerFlag_IgnoredByMonsters)) {
+						return true;
+					}
+				}
+				leafE = leafE->leafE;
+			} else {
+				leafE = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, nx + FLOOR_SIZE, ny);
+			}
+		}
+
+		if (leafS) {
+			leafS = leafS->leafS;
+		} else {
+			leafS = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, startx1, ny + FLOOR_SIZE);
+		}
+	}
+	return false;
+}
+
 void Map::clearSpectatorCache()
 {
 	spectatorCache.clear();
@@ -943,6 +1005,32 @@ Floor::~Floor()
 }
 
 // QTreeNode
+void Map::forEachTile(const QTreeNode* node, const std::function<void(const Tile*)>& callback)
+{
+	if (!node->isLeaf()) {
+		for (const QTreeNode* child : node->child) {
+			if (child) {
+				forEachTile(child, callback);
+			}
+		}
+		return;
+	}
+
+	for (const Floor* floor : static_cast<const QTreeLeafNode*>(node)->array) {
+		if (!floor) {
+			continue;
+		}
+
+		for (const auto& row : floor->tiles) {
+			for (const Tile* tile : row) {
+				if (tile) {
+					callback(tile);
+				}
+			}
+		}
+	}
+}
+
 QTreeNode::~QTreeNode()
 {
 	for (auto* ptr : child) {
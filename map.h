@@ -219,6 +219,13 @@ class Map
 		void clearSpectatorCache();
 		void clearPlayersSpectatorCache();
 
+		/**
+		  * Checks for a player in view of a position on the same floor, ignoring
+		  * players that monsters ignore. Sectors without players are skipped by
+		  * their player list size, the first player found ends the scan.
+		  */
+		bool isPlayerNearby(const Position& centerPos) const;
+
 		/**
 		  * Checks if you can throw an object to that position
 		  *	\param fromPos from Source point
@@ -257,6 +264,11 @@ class Map
 
 		std::map<std::string, Position> waypoints;
 
+		// calls callback for every tile of the map, in no particular order
+		void forEachTile(const std::function<void(const Tile*)>& callback) const {
+			forEachTile(&root, callback);
+		}
+
 		QTreeLeafNode* getQTNode(uint16_t x, uint16_t y) {
 			return QTreeNode::getLeafStatic<QTreeLeafNode*, QTreeNode*>(&root, x, y);
 		}
@@ -283,8 +295,11 @@ class Map
 		                           int32_t minRangeY, int32_t maxRangeY,
 		                           int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers) const;
 
+		static void forEachTile(const QTreeNode* node, const std::function<void(const Tile*)>& callback);
+
 		friend class Game;
 		friend class IOMap;
+		friend class IOMapSnapshot;
 };
 
 #endif
@@ -866,6 +866,7 @@ void Monster::doAttacking(uint32_t interval)
 
 	const Position& myPos = getPosition();
 	const Position& targetPos = attackedCreature->getPosition();
+	const int64_t now = OTSYS_TIME();
 
 	for (const spellBlock_t& spellBlock : mType->info.attackSpells) {
 		bool inRange = false;
@@ -874,8 +875,8 @@ void Monster::doAttacking(uint32_t interval)
 			break;
 		}
 
-		if (canUseSpell(myPos, targetPos, spellBlock, interval, inRange, resetTicks)) {
-			if (spellBlock.chance >= static_cast<uint32_t>(uniform_random(1, 100))) {
+		if (canUseSpell(myPos, targetPos, spellBlock, interval, now, inRange, resetTicks)) {
+			if (spellBlock.chance >= 100 || spellBlock.chance >= static_cast<uint32_t>(uniform_random(1, 100))) {
 				if (updateLook) {
 					updateLookDirection();
 					updateLook = false;
@@ -886,7 +887,7 @@ void Monster::doAttacking(uint32_t interval)
 				spellBlock.spell->castSpell(this, attackedCreature);
 
 				if (spellBlock.isMelee) {
-					lastMeleeAttack = OTSYS_TIME();
+					lastMeleeAttack = now;
 				}
 			}
 		}
@@ -911,23 +912,21 @@ bool Monster::canUseAttack(const Position& pos, const Creature* target) const
 	if (isHostile()) {
 		const Position& targetPos = target->getPosition();
 		uint32_t distance = std::max<uint32_t>(Position::getDistanceX(pos, targetPos), Position::getDistanceY(pos, targetPos));
-		for (const spellBlock_t& spellBlock : mType->info.attackSpells) {
-			if (spellBlock.range != 0 && distance <= spellBlock.range) {
-				return g_game.isSightClear(pos, targetPos, true);
-			}
+		if (mType->info.attackRange == 0 || distance > mType->info.attackRange) {
+			return false;
 		}
-		return false;
+		return g_game.isSightClear(pos, targetPos, true);
 	}
 	return true;
 }
 
 bool Monster::canUseSpell(const Position& pos, const Position& targetPos,
-                          const spellBlock_t& sb, uint32_t interval, bool& inRange, bool& resetTicks)
+                          const spellBlock_t& sb, uint32_t interval, int64_t now, bool& inRange, bool& resetTicks)
 {
 	inRange = true;
 
 	if (sb.isMelee) {
-		if (isFleeing() || (OTSYS_TIME() - lastMeleeAttack) < sb.speed) {
+		if (isFleeing() || (now - lastMeleeAttack) < sb.speed) {
 			return false;
 		}
 	} else {
@@ -1014,7 +1013,7 @@ void Monster::onThinkDefense(uint32_t interval)
 			continue;
 		}
 
-		if ((spellBlock.chance >= static_cast<uint32_t>(uniform_random(1, 100)))) {
+		if (spellBlock.chance >= 100 || spellBlock.chance >= static_cast<uint32_t>(uniform_random(1, 100))) {
 			minCombatValue = spellBlock.minCombatValue;
 			maxCombatValue = spellBlock.maxCombatValue;
 			spellBlock.spell->castSpell(this, this);
@@ -1048,7 +1047,7 @@ void Monster::onThinkDefense(uint32_t interval)
 				continue;
 			}
 
-			if (summonBlock.chance < static_cast<uint32_t>(uniform_random(1, 100))) {
+			if (summonBlock.chance < 100 && summonBlock.chance < static_cast<uint32_t>(uniform_random(1, 100))) {
 				continue;
 			}
 
@@ -2130,8 +2129,9 @@ void Monster::dropLoot(Container* corpse, Creature* mostDamageCreature)
         }
     }
 
+    static const ItemAttributes::CustomAttributeKey rarityKey = ItemAttributes::getCustomAttributeKey("rarity");
     for (Item* item : items) {
-        const auto rarityAttr = item->getCustomAttribute("rarity");
+        const auto rarityAttr = item->getCustomAttribute(rarityKey);
         if (!rarityAttr) {
             continue;
         }
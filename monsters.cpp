@@ -13,6 +13,8 @@
 
 #include "pugicast.h"
 
+#include <atomic>
+
 extern Game g_game;
 extern Spells* g_spells;
 extern Monsters g_monsters;
@@ -69,6 +71,66 @@ bool Monsters::loadFromXml(bool reloading /*= false*/)
 	return true;
 }
 
+bool Monsters::preloadFiles()
+{
+	pugi::xml_document doc;
+	pugi::xml_parse_result result = doc.load_file("data/monster/monsters.xml");
+	if (!result) {
+		printXMLError("Error - Monsters::preloadFiles", "data/monster/monsters.xml", result);
+		return false;
+	}
+
+	std::vector<std::string> files;
+	for (auto monsterNode : doc.child("monsters").children()) {
+		files.push_back("data/monster/" + std::string(monsterNode.attribute("file").as_string()));
+	}
+
+	std::atomic<size_t> nextFile{0};
+	auto worker = [&]() {
+		for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+			auto fileDoc = std::make_unique<pugi::xml_document>();
+			if (!fileDoc->load_file(files[i].c_str())) {
+				// reported when the monster is loaded
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lockGuard(preloadedFilesLock);
+			preloadedFiles[files[i]] = std::move(fileDoc);
+		}
+	};
+
+	size_t threadCount = std::min<size_t>(std::max<uint32_t>(1, std::thread::hardware_concurrency()), files.size());
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		workers.emplace_back(worker);
+	}
+
+	for (std::thread& thread : workers) {
+		thread.join();
+	}
+	return true;
+}
+
+void Monsters::clearPreloadedFiles()
+{
+	std::lock_guard<std::mutex> lockGuard(preloadedFilesLock);
+	preloadedFiles.clear();
+}
+
+std::unique_ptr<pugi::xml_document> Monsters::takePreloadedFile(const std::string& file)
+{
+	std::lock_guard<std::mutex> lockGuard(preloadedFilesLock);
+	auto it = preloadedFiles.find(file);
+	if (it == preloadedFiles.end()) {
+		return nullptr;
+	}
+
+	std::unique_ptr<pugi::xml_document> doc = std::move(it->second);
+	preloadedFiles.erase(it);
+	return doc;
+}
+
 bool Monsters::reload()
 {
 	loaded = false;
@@ -791,14 +853,17 @@ MonsterType* Monsters::loadMonster(const std::string& file, const std::string& m
 {
 	MonsterType* mType = nullptr;
 
-	pugi::xml_document doc;
-	pugi::xml_parse_result result = doc.load_file(file.c_str());
-	if (!result) {
-		printXMLError("Error - Monsters::loadMonster", file, result);
-		return nullptr;
+	std::unique_ptr<pugi::xml_document> doc = takePreloadedFile(file);
+	if (!doc) {
+		doc.reset(new pugi::xml_document);
+		pugi::xml_parse_result result = doc->load_file(file.c_str());
+		if (!result) {
+			printXMLError("Error - Monsters::loadMonster", file, result);
+			return nullptr;
+		}
 	}
 
-	pugi::xml_node monsterNode = doc.child("monster");
+	pugi::xml_node monsterNode = doc->child("monster");
 	if (!monsterNode) {
 		std::cout << "[Error - Monsters::loadMonster] Missing monster node in: " << file << std::endl;
 		return nullptr;
@@ -1398,9 +1463,18 @@ MonsterType* Monsters::loadMonster(const std::string& file, const std::string& m
 	mType->info.defenseSpells.shrink_to_fit();
 	mType->info.voiceVector.shrink_to_fit();
 	mType->info.scripts.shrink_to_fit();
+	mType->compileSpells();
 	return mType;
 }
 
+void MonsterType::compileSpells()
+{
+	info.attackRange = 0;
+	for (const spellBlock_t& spellBlock : info.attackSpells) {
+		info.attackRange = std::max(info.attackRange, spellBlock.range);
+	}
+}
+
 bool MonsterType::loadCallback(LuaScriptInterface* scriptInterface)
 {
 	int32_t id = scriptInterface->getEvent();
@@ -114,6 +114,7 @@ class MonsterType
 		uint32_t conditionImmunities = 0;
 		uint32_t damageImmunities = 0;
 		uint32_t baseSpeed = 200;
+		uint32_t attackRange = 0; // longest ranged attack, see compileSpells
 
 		int32_t creatureAppearEvent = -1;
 		int32_t creatureDisappearEvent = -1;
@@ -159,6 +160,10 @@ class MonsterType
 
 		bool loadCallback(LuaScriptInterface* scriptInterface);
 
+		// derives the per think lookups from the spell lists, called whenever
+		// they change
+		void compileSpells();
+
 		std::string name;
 		std::string nameDescription;
 
@@ -226,6 +231,11 @@ class Monsters
 		}
 		bool reload();
 
+		// parses every monster file listed in monsters.xml on a thread pool,
+		// loadMonster uses these documents instead of reading the file again
+		bool preloadFiles();
+		void clearPreloadedFiles();
+
 		MonsterType* getMonsterType(const std::string& name, bool loadFromFile = true);
 		bool deserializeSpell(MonsterSpell* spell, spellBlock_t& sb, const std::string& description = "");
 
@@ -242,8 +252,13 @@ class Monsters
 		void loadLootContainer(const pugi::xml_node& node, LootBlock&);
 		bool loadLootItem(const pugi::xml_node& node, LootBlock&);
 
+		std::unique_ptr<pugi::xml_document> takePreloadedFile(const std::string& file);
+
 		std::map<std::string, std::string> unloadedMonsters;
 
+		std::map<std::string, std::unique_ptr<pugi::xml_document>> preloadedFiles;
+		std::mutex preloadedFilesLock;
+
 		bool loaded = false;
 };
 
@@ -65,6 +65,32 @@ void MoveEvents::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void MoveEvents::clearScriptFile(const std::string& scriptFile)
+{
+	auto clearEventList = [&scriptFile](MoveEventList& eventList) {
+		for (int eventType = MOVE_EVENT_STEP_IN; eventType < MOVE_EVENT_LAST; ++eventType) {
+			auto& moveEvents = eventList.moveEvent[eventType];
+			for (auto it = moveEvents.begin(); it != moveEvents.end(); ) {
+				if (it->fromLua && it->scriptFile == scriptFile) {
+					it = moveEvents.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
+	};
+
+	for (MoveListMap* map : {&itemIdMap, &actionIdMap, &uniqueIdMap}) {
+		for (auto& it : *map) {
+			clearEventList(it.second);
+		}
+	}
+
+	for (auto& it : positionMap) {
+		clearEventList(it.second);
+	}
+}
+
 LuaScriptInterface& MoveEvents::getScriptInterface()
 {
 	return scriptInterface;
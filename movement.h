@@ -54,6 +54,7 @@ class MoveEvents final : public BaseEvents
 		bool registerLuaEvent(MoveEvent* event);
 		bool registerLuaFunction(MoveEvent* event);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 
 	private:
 		using MoveListMap = std::map<int32_t, MoveEventList>;
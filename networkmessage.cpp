@@ -7,6 +7,64 @@
 
 #include "container.h"
 #include "creature.h"
+#include "lockfree.h"
+
+namespace {
+
+// released buffers are kept for reuse, connections free them from the network threads
+using MediumBufferFreeList = LockfreeFreeList<NetworkMessage::MEDIUM_BUFFER_SIZE, 2048>;
+using LargeBufferFreeList = LockfreeFreeList<NETWORKMESSAGE_MAXSIZE, 64>;
+
+}
+
+bool NetworkMessage::grow(size_t size)
+{
+	if (size >= NETWORKMESSAGE_MAXSIZE) {
+		return false;
+	}
+
+	void* newBuffer;
+	uint32_t newCapacity;
+	if (size < MEDIUM_BUFFER_SIZE) {
+		newCapacity = MEDIUM_BUFFER_SIZE;
+		if (!MediumBufferFreeList::get().pop(newBuffer)) {
+			newBuffer = operator new(MEDIUM_BUFFER_SIZE);
+		}
+	} else {
+		newCapacity = NETWORKMESSAGE_MAXSIZE;
+		if (!LargeBufferFreeList::get().pop(newBuffer)) {
+			newBuffer = operator new(NETWORKMESSAGE_MAXSIZE);
+		}
+	}
+
+	memcpy(newBuffer, buffer, capacity);
+	releaseBuffer();
+
+	buffer = static_cast<uint8_t*>(newBuffer);
+	capacity = newCapacity;
+	return true;
+}
+
+void NetworkMessage::releaseBuffer()
+{
+	if (buffer == inlineBuffer) {
+		return;
+	}
+
+	bool pooled;
+	if (capacity == MEDIUM_BUFFER_SIZE) {
+		pooled = MediumBufferFreeList::get().bounded_push(buffer);
+	} else {
+		pooled = LargeBufferFreeList::get().bounded_push(buffer);
+	}
+
+	if (!pooled) {
+		operator delete(buffer);
+	}
+
+	buffer = inlineBuffer;
+	capacity = INLINE_BUFFER_SIZE;
+}
 
 std::string NetworkMessage::getString(uint16_t stringLen/* = 0*/)
 {
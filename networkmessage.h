@@ -28,7 +28,28 @@ class NetworkMessage
 		enum { MAX_BODY_LENGTH = NETWORKMESSAGE_MAXSIZE - HEADER_LENGTH - CHECKSUM_LENGTH - XTEA_MULTIPLE };
 		enum { MAX_PROTOCOL_BODY_LENGTH = MAX_BODY_LENGTH - 10 };
 
+		// Buffer size classes: most messages fit the inline buffer, bigger
+		// ones move to pooled 4 KB or full size buffers on demand.
+		static constexpr uint32_t INLINE_BUFFER_SIZE = 256;
+		static constexpr uint32_t MEDIUM_BUFFER_SIZE = 4096;
+
 		NetworkMessage() = default;
+		~NetworkMessage() {
+			releaseBuffer();
+		}
+
+		// non-copyable
+		NetworkMessage(const NetworkMessage&) = delete;
+		NetworkMessage& operator=(const NetworkMessage&) = delete;
+
+		// makes sure size bytes from the start of the buffer are writable
+		bool reserve(size_t size) {
+			return size < capacity || grow(size);
+		}
+
+		uint32_t getCapacity() const {
+			return capacity;
+		}
 
 		void reset() {
 			info = {};
@@ -115,7 +136,7 @@ class NetworkMessage
 		}
 
 		bool setBufferPosition(MsgSize_t pos) {
-			if (pos < NETWORKMESSAGE_MAXSIZE - INITIAL_BUFFER_POSITION) {
+			if (pos < NETWORKMESSAGE_MAXSIZE - INITIAL_BUFFER_POSITION && reserve(pos + INITIAL_BUFFER_POSITION)) {
 				info.position = pos + INITIAL_BUFFER_POSITION;
 				return true;
 			}
@@ -151,15 +172,26 @@ class NetworkMessage
 		};
 
 		NetworkMessageInfo info;
-		uint8_t buffer[NETWORKMESSAGE_MAXSIZE];
+		uint8_t* buffer = inlineBuffer;
+		uint32_t capacity = INLINE_BUFFER_SIZE;
 
-	private:
-		bool canAdd(size_t size) const {
-			return (size + info.position) < MAX_BODY_LENGTH;
+		bool canAdd(size_t size) {
+			// the tail past MAX_BODY_LENGTH is kept for the header, checksum and padding
+			size_t required = size + info.position;
+			if (required >= MAX_BODY_LENGTH) {
+				return false;
+			}
+			return required < capacity || grow(required);
 		}
 
+	private:
+		bool grow(size_t size);
+		void releaseBuffer();
+
+		uint8_t inlineBuffer[INLINE_BUFFER_SIZE];
+
 		bool canRead(int32_t size) {
-			if ((info.position + size) > (info.length + 8) || size >= (NETWORKMESSAGE_MAXSIZE - info.position)) {
+			if ((info.position + size) > (info.length + 8) || size >= static_cast<int32_t>(capacity - info.position)) {
 				info.overrun = true;
 				return false;
 			}
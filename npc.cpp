@@ -26,6 +26,18 @@ void Npcs::reload()
 	for (const auto& it : npcs) {
 		it.second->reload();
 	}
+
+	printScriptStats();
+}
+
+void Npcs::printScriptStats()
+{
+	const NpcScriptInterface* scriptInterface = Npc::scriptInterface;
+	if (!scriptInterface || scriptInterface->getScriptLoads() == 0) {
+		return;
+	}
+
+	std::cout << "> Loaded " << scriptInterface->getScriptLoads() << " npc scripts from " << scriptInterface->getCompiledScriptCount() << " files in " << scriptInterface->getScriptLoadTime() / 1000 << " ms, lua heap grew by " << scriptInterface->getScriptHeapGrowth() / 1024 << " KiB." << std::endl;
 }
 
 Npc* Npc::createNpc(const std::string& name)
@@ -354,13 +366,19 @@ void Npc::onPlayerCloseChannel(Player* player)
 
 void Npc::onThink(uint32_t interval)
 {
+	if (isIdle) {
+		// placed without players around, the creature check was added after onCreatureAppear
+		Game::removeCreatureCheck(this);
+		return;
+	}
+
 	Creature::onThink(interval);
 
 	if (npcEventHandler) {
 		npcEventHandler->onThink();
 	}
 
-	if (!isIdle && getTimeSinceLastMove() >= walkTicks) {
+	if (getTimeSinceLastMove() >= walkTicks) {
 		addEventWalk();
 	}
 }
@@ -416,7 +434,7 @@ bool Npc::getNextStep(Direction& dir, uint32_t& flags)
 		return false;
 	}
 
-	if (focusCreature != 0) {
+	if (focusCreature != 0 || isIdle) {
 		return false;
 	}
 
@@ -439,8 +457,12 @@ void Npc::setIdle(const bool idle)
 
 	isIdle = idle;
 
-	if (isIdle) {
+	// dormant npcs are taken off the creature checks, nobody is around to see them think or walk
+	if (!isIdle) {
+		g_game.addCreatureCheck(this);
+	} else {
 		onIdleStatus();
+		Game::removeCreatureCheck(this);
 	}
 }
 
@@ -599,13 +621,47 @@ bool NpcScriptInterface::initState()
 	return true;
 }
 
+NpcScriptInterface::~NpcScriptInterface()
+{
+	closeState();
+}
+
 bool NpcScriptInterface::closeState()
 {
+	if (luaState && g_luaEnvironment.getLuaState()) {
+		for (const auto& it : compiledScripts) {
+			luaL_unref(luaState, LUA_REGISTRYINDEX, it.second);
+		}
+	}
+	compiledScripts.clear();
+
 	libLoaded = false;
 	LuaScriptInterface::closeState();
 	return true;
 }
 
+int32_t NpcScriptInterface::loadNpcScript(const std::string& file, Npc* npc)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const size_t heapSize = g_luaEnvironment.getHeapSize();
+
+	auto it = compiledScripts.find(file);
+	if (it == compiledScripts.end()) {
+		if (compileFile(file) != 0) {
+			return -1;
+		}
+		it = compiledScripts.emplace(file, luaL_ref(luaState, LUA_REGISTRYINDEX)).first;
+	}
+
+	lua_rawgeti(luaState, LUA_REGISTRYINDEX, it->second);
+	int32_t ret = runFile(file, npc);
+
+	++scriptLoads;
+	scriptLoadTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	scriptHeapGrowth += static_cast<int64_t>(g_luaEnvironment.getHeapSize()) - static_cast<int64_t>(heapSize);
+	return ret;
+}
+
 bool NpcScriptInterface::loadNpcLib(const std::string& file)
 {
 	if (libLoaded) {
@@ -1123,7 +1179,7 @@ int NpcScriptInterface::luaNpcCloseShopWindow(lua_State* L)
 NpcEventsHandler::NpcEventsHandler(const std::string& file, Npc* npc) :
 	npc(npc), scriptInterface(npc->getScriptInterface())
 {
-	loaded = scriptInterface->loadFile("data/npc/scripts/" + file, npc) == 0;
+	loaded = scriptInterface->loadNpcScript("data/npc/scripts/" + file, npc) == 0;
 	if (!loaded) {
 		std::cout << "[Warning - NpcScript::NpcScript] Can not load script: " << file << std::endl;
 		std::cout << scriptInterface->getLastLuaError() << std::endl;
@@ -16,15 +16,35 @@ class Npcs
 {
 	public:
 		static void reload();
+		static void printScriptStats();
 };
 
 class NpcScriptInterface final : public LuaScriptInterface
 {
 	public:
 		NpcScriptInterface();
+		~NpcScriptInterface();
 
 		bool loadNpcLib(const std::string& file);
 
+		// runs a script for one npc, each file is compiled once and every npc
+		// runs its own call of the shared chunk, so the locals of the script
+		// stay per npc
+		int32_t loadNpcScript(const std::string& file, Npc* npc);
+
+		size_t getCompiledScriptCount() const {
+			return compiledScripts.size();
+		}
+		uint32_t getScriptLoads() const {
+			return scriptLoads;
+		}
+		int64_t getScriptLoadTime() const {
+			return scriptLoadTime;
+		}
+		int64_t getScriptHeapGrowth() const {
+			return scriptHeapGrowth;
+		}
+
 	private:
 		void registerFunctions();
 
@@ -52,6 +72,11 @@ class NpcScriptInterface final : public LuaScriptInterface
 		bool initState() override;
 		bool closeState() override;
 
+		std::map<std::string, int32_t> compiledScripts;
+		uint32_t scriptLoads = 0;
+		int64_t scriptLoadTime = 0; // microseconds
+		int64_t scriptHeapGrowth = 0; // bytes
+
 		bool libLoaded;
 };
 
@@ -166,6 +191,11 @@ class Npc final : public Creature
 		void turnToCreature(Creature* creature);
 		void setCreatureFocus(Creature* creature);
 
+		// no player can see the npc, it neither thinks nor walks
+		bool isDormant() const {
+			return isIdle;
+		}
+
 		NpcScriptInterface* getScriptInterface();
 
 		static uint32_t npcAutoID;
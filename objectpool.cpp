@@ -0,0 +1,249 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "objectpool.h"
+
+#include "bed.h"
+#include "combat.h"
+#include "container.h"
+#include "depotchest.h"
+#include "depotlocker.h"
+#include "house.h"
+#include "housetile.h"
+#include "inbox.h"
+#include "mailbox.h"
+#include "storeinbox.h"
+#include "teleport.h"
+#include "trashholder.h"
+
+namespace {
+
+constexpr size_t MAX_POOLS = 4;
+
+// objects moved between a thread's cache and the pool at once
+constexpr uint32_t CACHE_BATCH = 32;
+
+std::atomic<size_t> poolCount{0};
+
+static_assert(alignof(Container) <= ObjectPool::GRANULARITY && alignof(HouseTile) <= ObjectPool::GRANULARITY, "pooled objects are aligned to the size class granularity");
+
+}
+
+struct ObjectPool::ThreadCache
+{
+	CacheBin bins[MAX_POOLS][SIZE_CLASSES];
+	ObjectPool* pools[MAX_POOLS] = {};
+
+	~ThreadCache() {
+		for (size_t i = 0; i < MAX_POOLS; ++i) {
+			if (!pools[i]) {
+				continue;
+			}
+
+			for (size_t sizeClass = 0; sizeClass < SIZE_CLASSES; ++sizeClass) {
+				CacheBin& bin = bins[i][sizeClass];
+				if (bin.count != 0) {
+					pools[i]->release(sizeClass, bin, bin.count);
+				}
+			}
+		}
+	}
+
+	CacheBin& getBin(ObjectPool& pool, size_t sizeClass) {
+		pools[pool.id] = &pool;
+		return bins[pool.id][sizeClass];
+	}
+};
+
+ObjectPool::ObjectPool(std::string name) : name(std::move(name)), id(poolCount++)
+{
+	assert(id < MAX_POOLS);
+}
+
+ObjectPool& ObjectPool::getItemPool()
+{
+	// never destroyed, items are still deleted during static destruction
+	static ObjectPool* pool = new ObjectPool("Item");
+	return *pool;
+}
+
+ObjectPool& ObjectPool::getTilePool()
+{
+	static ObjectPool* pool = new ObjectPool("Tile");
+	return *pool;
+}
+
+ObjectPool::ThreadCache* ObjectPool::getThreadCache()
+{
+	// the cache outlives its owner as a plain pointer, objects freed after
+	// the owner is destroyed (e.g. during static destruction) go straight
+	// to the pool
+	static thread_local ThreadCache* cache = nullptr;
+	static thread_local bool destroyed = false;
+
+	struct Owner {
+		~Owner() {
+			delete cache;
+			cache = nullptr;
+			destroyed = true;
+		}
+	};
+	static thread_local Owner owner;
+
+	static_cast<void>(owner);
+
+	if (!cache && !destroyed) {
+		cache = new ThreadCache;
+	}
+	return cache;
+}
+
+void* ObjectPool::allocate(size_t size)
+{
+	size_t sizeClass = getSizeClass(size);
+	if (sizeClass >= SIZE_CLASSES) {
+		return ::operator new(size);
+	}
+
+	sizeClasses[sizeClass].live.fetch_add(1, std::memory_order_relaxed);
+
+	ThreadCache* cache = getThreadCache();
+	CacheBin uncachedBin;
+	CacheBin& bin = cache ? cache->getBin(*this, sizeClass) : uncachedBin;
+	if (!bin.head) {
+		refill(sizeClass, bin, cache ? CACHE_BATCH : 1);
+	}
+
+	FreeObject* object = bin.head;
+	bin.head = object->next;
+	--bin.count;
+	return object;
+}
+
+void ObjectPool::deallocate(void* p, size_t size)
+{
+	size_t sizeClass = getSizeClass(size);
+	if (sizeClass >= SIZE_CLASSES) {
+		::operator delete(p);
+		return;
+	}
+
+	sizeClasses[sizeClass].live.fetch_sub(1, std::memory_order_relaxed);
+
+	FreeObject* object = static_cast<FreeObject*>(p);
+
+	ThreadCache* cache = getThreadCache();
+	if (!cache) {
+		CacheBin bin;
+		object->next = nullptr;
+		bin.head = object;
+		bin.count = 1;
+		release(sizeClass, bin, 1);
+		return;
+	}
+
+	CacheBin& bin = cache->getBin(*this, sizeClass);
+	object->next = bin.head;
+	bin.head = object;
+	if (++bin.count >= 2 * CACHE_BATCH) {
+		release(sizeClass, bin, CACHE_BATCH);
+	}
+}
+
+void ObjectPool::refill(size_t sizeClass, CacheBin& bin, uint32_t count)
+{
+	SizeClass& shared = sizeClasses[sizeClass];
+	const size_t objectSize = (sizeClass + 1) * GRANULARITY;
+
+	std::lock_guard<std::mutex> lockGuard(shared.lock);
+	for (uint32_t i = 0; i < count; ++i) {
+		FreeObject* object = shared.freeList;
+		if (object) {
+			shared.freeList = object->next;
+		} else {
+			if (static_cast<size_t>(shared.slabEnd - shared.slabPos) < objectSize) {
+				shared.slabPos = static_cast<char*>(::operator new(SLAB_SIZE));
+				shared.slabEnd = shared.slabPos + SLAB_SIZE;
+			}
+
+			object = reinterpret_cast<FreeObject*>(shared.slabPos);
+			shared.slabPos += objectSize;
+			++shared.capacity;
+		}
+
+		object->next = bin.head;
+		bin.head = object;
+		++bin.count;
+	}
+}
+
+void ObjectPool::release(size_t sizeClass, CacheBin& bin, uint32_t count)
+{
+	SizeClass& shared = sizeClasses[sizeClass];
+
+	std::lock_guard<std::mutex> lockGuard(shared.lock);
+	for (uint32_t i = 0; i < count && bin.head; ++i) {
+		FreeObject* object = bin.head;
+		bin.head = object->next;
+		--bin.count;
+
+		object->next = shared.freeList;
+		shared.freeList = object;
+	}
+}
+
+std::vector<ObjectPool::SizeClassStats> ObjectPool::getStats() const
+{
+	std::vector<SizeClassStats> stats;
+	for (size_t sizeClass = 0; sizeClass < SIZE_CLASSES; ++sizeClass) {
+		const SizeClass& shared = sizeClasses[sizeClass];
+
+		std::lock_guard<std::mutex> lockGuard(shared.lock);
+		if (shared.capacity == 0) {
+			continue;
+		}
+
+		int64_t live = shared.live.load(std::memory_order_relaxed);
+		stats.push_back({(sizeClass + 1) * GRANULARITY, static_cast<uint64_t>(std::max<int64_t>(live, 0)), shared.capacity});
+	}
+	return stats;
+}
+
+std::string ObjectPool::getTypeNames(size_t objectSize) const
+{
+	static const std::vector<std::pair<const char*, size_t>> itemTypes = {
+		{"Item", sizeof(Item)},
+		{"Container", sizeof(Container)},
+		{"DepotChest", sizeof(DepotChest)},
+		{"DepotLocker", sizeof(DepotLocker)},
+		{"Inbox", sizeof(Inbox)},
+		{"StoreInbox", sizeof(StoreInbox)},
+		{"Teleport", sizeof(Teleport)},
+		{"Door", sizeof(Door)},
+		{"BedItem", sizeof(BedItem)},
+		{"MagicField", sizeof(MagicField)},
+		{"TrashHolder", sizeof(TrashHolder)},
+		{"Mailbox", sizeof(Mailbox)},
+	};
+
+	static const std::vector<std::pair<const char*, size_t>> tileTypes = {
+		{"StaticTile", sizeof(StaticTile)},
+		{"DynamicTile", sizeof(DynamicTile)},
+		{"HouseTile", sizeof(HouseTile)},
+	};
+
+	std::string names;
+	for (const auto& it : this == &getTilePool() ? tileTypes : itemTypes) {
+		if (getSizeClass(it.second) != getSizeClass(objectSize)) {
+			continue;
+		}
+
+		if (!names.empty()) {
+			names.append(", ");
+		}
+		names.append(it.first);
+	}
+	return names;
+}
@@ -0,0 +1,83 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#ifndef FS_OBJECTPOOL_H_5679E4C2437943949374FDB795CF698C
+#define FS_OBJECTPOOL_H_5679E4C2437943949374FDB795CF698C
+
+// Size-class allocator for the classes the map is made of (tiles and items),
+// plugged in through their class-specific operator new/delete so it covers
+// every derived type. Objects are carved from slabs and recycled through a
+// free list per object size, slabs are never given back to the system, so
+// long uptimes do not fragment the general heap. Every thread caches a few
+// objects per size class, the map loader threads rarely take the lock.
+class ObjectPool
+{
+	public:
+		static constexpr size_t GRANULARITY = 8; // alignment of the pooled types
+		static constexpr size_t SIZE_CLASSES = 64; // objects up to 512 bytes
+		static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+		struct SizeClassStats {
+			size_t objectSize;
+			uint64_t live;
+			uint64_t capacity;
+		};
+
+		explicit ObjectPool(std::string name);
+
+		// non-copyable
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+
+		void* allocate(size_t size);
+		void deallocate(void* p, size_t size);
+
+		const std::string& getName() const {
+			return name;
+		}
+
+		// size classes that ever had an object
+		std::vector<SizeClassStats> getStats() const;
+
+		// the pooled types sharing the size class of objectSize
+		std::string getTypeNames(size_t objectSize) const;
+
+		static ObjectPool& getItemPool();
+		static ObjectPool& getTilePool();
+
+	private:
+		struct FreeObject {
+			FreeObject* next;
+		};
+
+		struct SizeClass {
+			mutable std::mutex lock;
+			FreeObject* freeList = nullptr;
+			char* slabPos = nullptr;
+			char* slabEnd = nullptr;
+			uint64_t capacity = 0;
+			std::atomic<int64_t> live{0};
+		};
+
+		struct CacheBin {
+			FreeObject* head = nullptr;
+			uint32_t count = 0;
+		};
+
+		struct ThreadCache;
+
+		static size_t getSizeClass(size_t size) {
+			return (size - 1) / GRANULARITY;
+		}
+
+		static ThreadCache* getThreadCache();
+
+		void refill(size_t sizeClass, CacheBin& bin, uint32_t count);
+		void release(size_t sizeClass, CacheBin& bin, uint32_t count);
+
+		SizeClass sizeClasses[SIZE_CLASSES];
+		std::string name;
+		size_t id;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include "scheduler.h"
 #include "databasetasks.h"
 #include "script.h"
+#include "loadergraph.h"
 #include <fstream>
 #include <fmt/color.h>
 #if __has_include("gitmetadata.h")
@@ -34,6 +35,7 @@ ConfigManager g_config;
 Monsters g_monsters;
 Vocations g_vocations;
 extern Scripts* g_scripts;
+extern LuaEnvironment g_luaEnvironment;
 RSA g_RSA;
 
 std::mutex g_loaderLock;
@@ -164,6 +166,10 @@ void mainLoader(int, char*[], ServiceManager* services)
 		return;
 	}
 
+	// the shared lua state is created before the config is read
+	g_luaEnvironment.setGarbageCollectorParameters();
+	g_dispatcher.setIdleHandler([]() { return g_luaEnvironment.collectGarbageStep(); });
+
 #ifdef _WIN32
 	const std::string& defaultPriority = g_config.getString(ConfigManager::DEFAULT_PRIORITY);
 	if (strcasecmp(defaultPriority.c_str(), "high") == 0) {
@@ -206,54 +212,72 @@ void mainLoader(int, char*[], ServiceManager* services)
 		std::cout << "> No tables were optimized." << std::endl;
 	}
 
-	//load vocations
-	std::cout << ">> Loading vocations" << std::endl;
-	if (!g_vocations.loadFromXml()) {
-		startupErrorMessage("Unable to load vocations!");
-		return;
-	}
-
-	// load item data
-	std::cout << ">> Loading items" << std::endl;
-	if (!Item::items.loadFromOtb("data/items/items.otb")) {
-		startupErrorMessage("Unable to load items (OTB)!");
-		return;
-	}
-
-	if (!Item::items.loadFromXml()) {
-		startupErrorMessage("Unable to load items (XML)!");
-		return;
-	}
-
-	std::cout << ">> Loading script systems" << std::endl;
-	if (!ScriptingManager::getInstance().loadScriptSystems()) {
-		startupErrorMessage("Failed to load script systems");
-		return;
-	}
-
-	std::cout << ">> Loading lua scripts" << std::endl;
-	if (!g_scripts->loadScripts("scripts", false, false)) {
-		startupErrorMessage("Failed to load lua scripts");
-		return;
-	}
-
-	std::cout << ">> Loading monsters" << std::endl;
-	if (!g_monsters.loadFromXml()) {
-		startupErrorMessage("Unable to load monsters!");
-		return;
-	}
+	// xml loaders run on worker threads, everything registering lua stays
+	// on the dispatcher thread
+	LoaderGraph loaders;
+	loaders.addWorkerTask("vocations", {}, "Unable to load vocations!", []() {
+		return g_vocations.loadFromXml();
+	});
+	loaders.addWorkerTask("items", {}, "Unable to load items!", []() {
+		if (!Item::items.loadFromOtb("data/items/items.otb")) {
+			std::cout << "[Error - mainLoader] Unable to load items (OTB)!" << std::endl;
+			return false;
+		}
 
-	std::cout << ">> Loading lua monsters" << std::endl;
-	if (!g_scripts->loadScripts("monster", false, false)) {
-		startupErrorMessage("Failed to load lua monsters");
+		if (!Item::items.loadFromXml()) {
+			std::cout << "[Error - mainLoader] Unable to load items (XML)!" << std::endl;
+			return false;
+		}
+		return true;
+	});
+	loaders.addWorkerTask("outfits", {}, "Unable to load outfits!", []() {
+		return Outfits::getInstance().loadFromXml();
+	});
+	loaders.addWorkerTask("monster files", {}, "Unable to load monsters!", []() {
+		return g_monsters.preloadFiles();
+	});
+
+	// these were never fatal
+	loaders.addWorkerTask("quests", {}, "", []() {
+		g_game.quests.loadFromXml();
+		return true;
+	});
+	loaders.addWorkerTask("mounts", {}, "", []() {
+		g_game.mounts.loadFromXml();
+		return true;
+	});
+	loaders.addWorkerTask("auras", {}, "", []() {
+		g_game.auras.loadFromXml();
+		return true;
+	});
+	loaders.addWorkerTask("wings", {}, "", []() {
+		g_game.wings.loadFromXml();
+		return true;
+	});
+	loaders.addWorkerTask("shaders", {}, "", []() {
+		g_game.shaders.loadFromXml();
+		return true;
+	});
+
+	loaders.addMainTask("script systems", {"vocations", "items"}, "Failed to load script systems", []() {
+		return ScriptingManager::getInstance().loadScriptSystems();
+	});
+	loaders.addMainTask("lua scripts", {"script systems"}, "Failed to load lua scripts", []() {
+		return g_scripts->loadScripts("scripts", false, false);
+	});
+	loaders.addMainTask("monsters", {"lua scripts", "monster files"}, "Unable to load monsters!", []() {
+		return g_monsters.loadFromXml();
+	});
+	loaders.addMainTask("lua monsters", {"monsters"}, "Failed to load lua monsters", []() {
+		return g_scripts->loadScripts("monster", false, false);
+	});
+
+	if (!loaders.run()) {
+		startupErrorMessage(loaders.getError());
 		return;
 	}
 
-	std::cout << ">> Loading outfits" << std::endl;
-	if (!Outfits::getInstance().loadFromXml()) {
-		startupErrorMessage("Unable to load outfits!");
-		return;
-	}
+	g_scripts->startWatcher();
 
 	std::cout << ">> Checking world type... " << std::flush;
 	std::string worldType = asLowerCaseString(g_config.getString(ConfigManager::WORLD_TYPE));
@@ -276,6 +300,9 @@ void mainLoader(int, char*[], ServiceManager* services)
 		return;
 	}
 
+	// the spawns loaded the monsters they use, the rest loads from disk
+	g_monsters.clearPreloadedFiles();
+
 	std::cout << ">> Initializing gamestate" << std::endl;
 	g_game.setGameState(GAME_STATE_INIT);
 
@@ -306,6 +333,7 @@ void mainLoader(int, char*[], ServiceManager* services)
 
 	g_game.map.houses.payHouses(rentPeriod);
 
+	IOMarket::getInstance().loadOffers();
 	IOMarket::checkExpiredOffers();
 	IOMarket::getInstance().updateStatistics();
 
@@ -320,6 +348,8 @@ void mainLoader(int, char*[], ServiceManager* services)
 	g_game.start(services);
 	g_game.setGameState(GAME_STATE_NORMAL);
 	g_loaderSignal.notify_all();
+
+	loaders.printTimings();
 }
 
 bool argumentsHandler(const StringVector& args)
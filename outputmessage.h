@@ -37,16 +37,17 @@ class OutputMessage : public NetworkMessage
 
 		void append(const NetworkMessage& msg) {
 			auto msgLen = msg.getLength();
+			if (!canAdd(msgLen)) {
+				return;
+			}
+
 			memcpy(buffer + info.position, msg.getBuffer() + 8, msgLen);
 			info.length += msgLen;
 			info.position += msgLen;
 		}
 
 		void append(const OutputMessage_ptr& msg) {
-			auto msgLen = msg->getLength();
-			memcpy(buffer + info.position, msg->getBuffer() + 8, msgLen);
-			info.length += msgLen;
-			info.position += msgLen;
+			append(*msg);
 		}
 
 	private:
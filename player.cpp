@@ -2829,6 +2829,7 @@ void Player::addThing(int32_t index, Thing* thing)
 
 	item->setParent(this);
 	inventory[index] = item;
+	addToInventoryIndex(item);
 
 	//send to client
 	sendInventoryItem(static_cast<slots_t>(index), item);
@@ -2846,8 +2847,10 @@ void Player::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
 		return /*RETURNVALUE_NOTPOSSIBLE*/;
 	}
 
+	removeFromInventoryIndex(item, false);
 	item->setID(itemId);
 	item->setSubType(count);
+	addToInventoryIndex(item, false);
 
 	//send to client
 	sendInventoryItem(static_cast<slots_t>(index), item);
@@ -2881,6 +2884,8 @@ void Player::replaceThing(uint32_t index, Thing* thing)
 	item->setParent(this);
 
 	inventory[index] = item;
+	removeFromInventoryIndex(oldItem);
+	addToInventoryIndex(item);
 }
 
 void Player::removeThing(Thing* thing, uint32_t count)
@@ -2903,11 +2908,14 @@ void Player::removeThing(Thing* thing, uint32_t count)
 			//event methods
 			onRemoveInventoryItem(item);
 
+			removeFromInventoryIndex(item);
 			item->setParent(nullptr);
 			inventory[index] = nullptr;
 		} else {
 			uint8_t newCount = static_cast<uint8_t>(std::max<int32_t>(0, item->getItemCount() - count));
+			removeFromInventoryIndex(item, false);
 			item->setItemCount(newCount);
+			addToInventoryIndex(item, false);
 
 			//send change to client
 			sendInventoryItem(static_cast<slots_t>(index), item);
@@ -2922,6 +2930,7 @@ void Player::removeThing(Thing* thing, uint32_t count)
 		//event methods
 		onRemoveInventoryItem(item);
 
+		removeFromInventoryIndex(item);
 		item->setParent(nullptr);
 		inventory[index] = nullptr;
 	}
@@ -2949,6 +2958,18 @@ size_t Player::getLastIndex() const
 
 uint32_t Player::getItemTypeCount(uint16_t itemId, int32_t subType /*= -1*/) const
 {
+	assert(checkInventoryIndex());
+
+	auto it = inventoryItemCounts.find(itemId);
+	if (it == inventoryItemCounts.end()) {
+		return 0;
+	}
+
+	if (subType == -1) {
+		return it->second;
+	}
+
+	// fluid types and charges are not indexed
 	uint32_t count = 0;
 	for (int32_t i = CONST_SLOT_FIRST; i <= CONST_SLOT_LAST; i++) {
 		Item* item = inventory[i];
@@ -2977,6 +2998,10 @@ bool Player::removeItemOfType(uint16_t itemId, uint32_t amount, int32_t subType,
 		return true;
 	}
 
+	if (getItemTypeCount(itemId) < amount) {
+		return false;
+	}
+
 	std::vector<Item*> itemList;
 
 	uint32_t count = 0;
@@ -3024,21 +3049,93 @@ bool Player::removeItemOfType(uint16_t itemId, uint32_t amount, int32_t subType,
 
 std::map<uint32_t, uint32_t>& Player::getAllItemTypeCount(std::map<uint32_t, uint32_t>& countMap) const
 {
+	assert(checkInventoryIndex());
+
+	for (const auto& it : inventoryItemCounts) {
+		countMap[it.first] += it.second;
+	}
+	return countMap;
+}
+
+void Player::addToInventoryIndex(const Item* item, bool recursive /*= true*/)
+{
+	inventoryItemCounts[item->getID()] += item->getItemCount();
+	inventoryMoney += item->getWorth();
+
+	if (recursive) {
+		if (const Container* container = item->getContainer()) {
+			for (ContainerIterator it = container->iterator(); it.hasNext(); it.advance()) {
+				addToInventoryIndex(*it, false);
+			}
+		}
+	}
+}
+
+void Player::removeFromInventoryIndex(const Item* item, bool recursive /*= true*/)
+{
+	auto it = inventoryItemCounts.find(item->getID());
+	if (it != inventoryItemCounts.end()) {
+		it->second -= std::min<uint32_t>(it->second, item->getItemCount());
+		if (it->second == 0) {
+			inventoryItemCounts.erase(it);
+		}
+	}
+	inventoryMoney -= std::min<uint64_t>(inventoryMoney, item->getWorth());
+
+	if (recursive) {
+		if (const Container* container = item->getContainer()) {
+			for (ContainerIterator it = container->iterator(); it.hasNext(); it.advance()) {
+				removeFromInventoryIndex(*it, false);
+			}
+		}
+	}
+}
+
+bool Player::checkInventoryIndex() const
+{
+	std::unordered_map<uint16_t, uint32_t> itemCounts;
+	uint64_t money = 0;
 	for (int32_t i = CONST_SLOT_FIRST; i <= CONST_SLOT_LAST; i++) {
 		Item* item = inventory[i];
 		if (!item) {
 			continue;
 		}
 
-		countMap[item->getID()] += Item::countByType(item, -1);
+		itemCounts[item->getID()] += item->getItemCount();
+		money += item->getWorth();
 
 		if (Container* container = item->getContainer()) {
 			for (ContainerIterator it = container->iterator(); it.hasNext(); it.advance()) {
-				countMap[(*it)->getID()] += Item::countByType(*it, -1);
+				itemCounts[(*it)->getID()] += (*it)->getItemCount();
+				money += (*it)->getWorth();
 			}
 		}
 	}
-	return countMap;
+
+	bool valid = true;
+	if (money != inventoryMoney) {
+		std::cout << "[Error - Player::checkInventoryIndex] " << name << " holds " << money << " gold, the index says " << inventoryMoney << '.' << std::endl;
+		valid = false;
+	}
+
+	for (const auto& it : itemCounts) {
+		auto indexIt = inventoryItemCounts.find(it.first);
+		uint32_t indexCount = indexIt != inventoryItemCounts.end() ? indexIt->second : 0;
+		if (indexCount != it.second) {
+			std::cout << "[Error - Player::checkInventoryIndex] " << name << " holds " << it.second << "x " << it.first << ", the index says " << indexCount << '.' << std::endl;
+			valid = false;
+		}
+	}
+
+	if (itemCounts.size() != inventoryItemCounts.size()) {
+		for (const auto& it : inventoryItemCounts) {
+			if (itemCounts.find(it.first) == itemCounts.end()) {
+				std::cout << "[Error - Player::checkInventoryIndex] " << name << " holds no " << it.first << ", the index says " << it.second << '.' << std::endl;
+				valid = false;
+			}
+		}
+	}
+	return valid;
 }
 
 Thing* Player::getThing(size_t index) const
@@ -3216,6 +3313,7 @@ void Player::internalAddThing(uint32_t index, Thing* thing)
 
 		inventory[index] = item;
 		item->setParent(this);
+		addToInventoryIndex(item);
 	}
 }
 
@@ -4771,36 +4869,8 @@ void Player::sendClosePrivate(uint16_t channelId)
 
 uint64_t Player::getMoney() const
 {
-	std::vector<const Container*> containers;
-	uint64_t moneyCount = 0;
-
-	for (int32_t i = CONST_SLOT_FIRST; i <= CONST_SLOT_LAST; ++i) {
-		Item* item = inventory[i];
-		if (!item) {
-			continue;
-		}
-
-		const Container* container = item->getContainer();
-		if (container) {
-			containers.push_back(container);
-		} else {
-			moneyCount += item->getWorth();
-		}
-	}
-
-	size_t i = 0;
-	while (i < containers.size()) {
-		const Container* container = containers[i++];
-		for (const Item* item : container->getItemList()) {
-			const Container* tmpContainer = item->getContainer();
-			if (tmpContainer) {
-				containers.push_back(tmpContainer);
-			} else {
-				moneyCount += item->getWorth();
-			}
-		}
-	}
-	return moneyCount;
+	assert(checkInventoryIndex());
+	return inventoryMoney;
 }
 
 size_t Player::getMaxVIPEntries() const
@@ -597,6 +597,14 @@ class Player final : public Creature, public Cylinder
 
 		uint64_t getMoney() const;
 
+		// item id -> count and the coin worth of everything in the inventory
+		// slots and their containers, kept up to date by the cylinder methods
+		// of the player and its containers
+		void addToInventoryIndex(const Item* item, bool recursive = true);
+		void removeFromInventoryIndex(const Item* item, bool recursive = true);
+		// cross-checks the index against a full scan of the inventory
+		bool checkInventoryIndex() const;
+
 		Item* getItemByUID(uint32_t uid) const;
 		//safe-trade functions
 		void setTradeState(tradestate_t state) {
@@ -1171,7 +1179,7 @@ class Player final : public Creature, public Cylinder
 			}
 		}
 
-		void sendChannel(uint16_t channelId, const std::string& channelName, const UsersMap* channelUsers, const InvitedMap* invitedUsers) {
+		void sendChannel(uint16_t channelId, const std::string& channelName, const UsersList* channelUsers, const InvitedMap* invitedUsers) {
 			if (client) {
 				client->sendChannel(channelId, channelName, channelUsers, invitedUsers);
 			}
@@ -1206,9 +1214,12 @@ class Player final : public Creature, public Cylinder
 				client->sendFightModes();
 			}
 		}
-		void sendNetworkMessage(const NetworkMessage& message) {
+		uint32_t getSendBacklog() const {
+			return client ? client->getSendBacklog() : 0;
+		}
+		void sendNetworkMessage(const NetworkMessage& message, PacketClass_t packetClass = PACKET_CRITICAL) {
 			if (client) {
-				client->writeToOutputBuffer(message);
+				client->writeToOutputBuffer(message, packetClass);
 			}
 		}
 
@@ -1383,6 +1394,8 @@ class Player final : public Creature, public Cylinder
 		Vocation* vocation = nullptr;
 		StoreInbox* storeInbox = nullptr;
 
+		std::unordered_map<uint16_t, uint32_t> inventoryItemCounts;
+		uint64_t inventoryMoney = 0;
 		uint32_t inventoryWeight = 0;
 		uint32_t capacity = 40000;
 		uint32_t damageImmunities = 0;
@@ -14,6 +14,7 @@
 #include "configmanager.h"
 #include "actions.h"
 #include "game.h"
+#include "iodelivery.h"
 #include "iologindata.h"
 #include "iomarket.h"
 #include "ban.h"
@@ -26,6 +27,10 @@ extern Actions actions;
 extern CreatureEvents* g_creatureEvents;
 extern Chat* g_chat;
 
+TileItemsCacheStats ProtocolGame::tileCacheStats;
+std::array<BroadcastStats, BROADCAST_LAST + 1> ProtocolGame::broadcastStats;
+std::array<PacketClassStats, PACKET_CLASS_LAST + 1> ProtocolGame::packetStats;
+
 namespace {
 
 using WaitList = std::deque<std::pair<int64_t, uint32_t>>; // (timeout, player guid)
@@ -211,27 +216,8 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 			return;
 		}
 
-		if (!IOLoginData::loadPlayerById(player, player->getGUID())) {
-			disconnectClient("Your character could not be loaded.");
-			return;
-		}
-
-		player->setOperatingSystem(operatingSystem);
-
-		if (!g_game.placeCreature(player, player->getLoginPosition())) {
-			if (!g_game.placeCreature(player, player->getTemplePosition(), false, true)) {
-				disconnectClient("Temple position is wrong. Contact the administrator.");
-				return;
-			}
-		}
-
-		if (operatingSystem >= CLIENTOS_OTCLIENT_LINUX) {
-			player->registerCreatureEvent("ExtendedOpcode");
-		}
-
-		player->lastIP = player->getIP();
-		player->lastLoginSaved = std::max<time_t>(time(nullptr), player->lastLoginSaved + 1);
-		acceptPackets = true;
+		// items and gold delivered while offline must be written before the player is loaded
+		IODelivery::whenDelivered(player->getGUID(), std::bind(&ProtocolGame::finishLogin, getThis(), operatingSystem));
 	} else {
 		if (eventConnect != 0 || !g_config.getBoolean(ConfigManager::REPLACE_KICK_ON_LOGIN)) {
 			//Already trying to connect
@@ -251,6 +237,42 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 	OutputMessagePool::getInstance().addProtocolToAutosend(shared_from_this());
 }
 
+void ProtocolGame::finishLogin(OperatingSystem_t operatingSystem)
+{
+	//dispatcher thread
+	if (!player || isConnectionExpired()) {
+		return;
+	}
+
+	// another login for the character may have finished while this one waited
+	if (!g_config.getBoolean(ConfigManager::ALLOW_CLONES) && g_game.getPlayerByGUID(player->getGUID())) {
+		disconnectClient("You are already logged in.");
+		return;
+	}
+
+	if (!IOLoginData::loadPlayerById(player, player->getGUID())) {
+		disconnectClient("Your character could not be loaded.");
+		return;
+	}
+
+	player->setOperatingSystem(operatingSystem);
+
+	if (!g_game.placeCreature(player, player->getLoginPosition())) {
+		if (!g_game.placeCreature(player, player->getTemplePosition(), false, true)) {
+			disconnectClient("Temple position is wrong. Contact the administrator.");
+			return;
+		}
+	}
+
+	if (operatingSystem >= CLIENTOS_OTCLIENT_LINUX) {
+		player->registerCreatureEvent("ExtendedOpcode");
+	}
+
+	player->lastIP = player->getIP();
+	player->lastLoginSaved = std::max<time_t>(time(nullptr), player->lastLoginSaved + 1);
+	acceptPackets = true;
+}
+
 void ProtocolGame::connect(uint32_t playerId, OperatingSystem_t operatingSystem)
 {
 	eventConnect = 0;
@@ -462,10 +484,36 @@ void ProtocolGame::disconnectClient(const std::string& message) const
 	disconnect();
 }
 
-void ProtocolGame::writeToOutputBuffer(const NetworkMessage& msg)
+void ProtocolGame::writeToOutputBuffer(const NetworkMessage& msg, PacketClass_t packetClass/* = PACKET_CRITICAL*/)
 {
+	PacketClassStats& stats = packetStats[packetClass];
+	if (packetClass == PACKET_COSMETIC) {
+		const uint32_t budget = g_config.getNumber(ConfigManager::MAX_QUEUED_SEND_BYTES);
+		if (budget != 0 && getSendBacklog() > budget) {
+			++stats.droppedPackets;
+			stats.droppedBytes += msg.getLength();
+			return;
+		}
+	}
+
 	auto out = getOutputBuffer(msg.getLength());
 	out->append(msg);
+
+	++stats.packets;
+	stats.bytes += msg.getLength();
+}
+
+uint32_t ProtocolGame::getSendBacklog()
+{
+	uint32_t backlog = 0;
+	if (auto connection = getConnection()) {
+		backlog = connection->getQueuedBytes();
+	}
+
+	if (const auto& out = getCurrentBuffer()) {
+		backlog += out->getLength();
+	}
+	return backlog;
 }
 
 void ProtocolGame::parsePacket(NetworkMessage& msg)
@@ -592,30 +640,57 @@ void ProtocolGame::parsePacket(NetworkMessage& msg)
 	}
 }
 
-void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
+const TileItemsCache& ProtocolGame::getTileItemsCache(const Tile* tile)
 {
-	msg.add<uint16_t>(0x00); //environmental effects
+	TileItemsCache* cache = tile->getItemsCache();
+	if (cache) {
+		++tileCacheStats.hits;
+		return *cache;
+	}
 
-	int32_t count;
-	Item* ground = tile->getGround();
-	if (ground) {
-		msg.addItem(ground);
-		count = 1;
-	} else {
-		count = 0;
+	++tileCacheStats.misses;
+	cache = &tile->makeItemsCache(tileCacheStats);
+
+	NetworkMessage encoder;
+	if (Item* ground = tile->getGround()) {
+		encoder.addItem(ground);
+		++cache->topItemCount;
 	}
 
 	const TileItemVector* items = tile->getItemList();
 	if (items) {
-		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end; ++it) {
-			msg.addItem(*it);
+		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end && cache->topItemCount < 10; ++it) {
+			encoder.addItem(*it);
+			++cache->topItemCount;
+		}
+	}
+	cache->topItemsEnd = encoder.getLength();
 
-			if (++count == 10) {
-				break;
-			}
+	// without creatures in between at most 10 - topItemCount down items are sent
+	if (items) {
+		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end && cache->topItemCount + cache->downItemCount < 10; ++it) {
+			encoder.addItem(*it);
+			cache->downItemEnd[cache->downItemCount++] = encoder.getLength();
 		}
 	}
 
+	const uint8_t* encoded = encoder.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION;
+	cache->buffer.assign(encoded, encoded + encoder.getLength());
+	return *cache;
+}
+
+void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
+{
+	msg.add<uint16_t>(0x00); //environmental effects
+
+	const uint64_t hits = tileCacheStats.hits;
+	const TileItemsCache& cache = getTileItemsCache(tile);
+	const char* encoded = reinterpret_cast<const char*>(cache.buffer.data());
+
+	int32_t count = cache.topItemCount;
+	size_t bytes = cache.topItemsEnd;
+	msg.addBytes(encoded, cache.topItemsEnd);
+
 	const CreatureVector* creatures = tile->getCreatures();
 	if (creatures) {
 		for (const Creature* creature : boost::adaptors::reverse(*creatures)) {
@@ -631,14 +706,14 @@ void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
 		}
 	}
 
-	if (items && count < 10) {
-		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end; ++it) {
-			msg.addItem(*it);
+	if (count < 10 && cache.downItemCount != 0) {
+		size_t downItemEnd = cache.downItemEnd[std::min<int32_t>(cache.downItemCount, 10 - count) - 1];
+		msg.addBytes(encoded + cache.topItemsEnd, downItemEnd - cache.topItemsEnd);
+		bytes = downItemEnd;
+	}
 
-			if (++count == 10) {
-				return;
-			}
-		}
+	if (tileCacheStats.hits != hits) {
+		tileCacheStats.bytesServed += bytes;
 	}
 }
 
@@ -1483,7 +1558,13 @@ void ProtocolGame::sendTextMessage(const TextMessage& message)
 		}
 	}
 	msg.addString(message.text);
-	writeToOutputBuffer(msg);
+
+	// numbers shown over other creatures are decoration, the own ones are not
+	if (message.type == MESSAGE_DAMAGE_OTHERS || message.type == MESSAGE_HEALED_OTHERS || message.type == MESSAGE_EXPERIENCE_OTHERS) {
+		writeToOutputBuffer(msg, PACKET_COSMETIC);
+	} else {
+		writeToOutputBuffer(msg);
+	}
 }
 
 void ProtocolGame::sendClosePrivate(uint16_t channelId)
@@ -1521,7 +1602,7 @@ void ProtocolGame::sendChannelsDialog()
 	writeToOutputBuffer(msg);
 }
 
-void ProtocolGame::sendChannel(uint16_t channelId, const std::string& channelName, const UsersMap* channelUsers, const InvitedMap* invitedUsers)
+void ProtocolGame::sendChannel(uint16_t channelId, const std::string& channelName, const UsersList* channelUsers, const InvitedMap* invitedUsers)
 {
 	NetworkMessage msg;
 	msg.addByte(0xAC);
@@ -1531,8 +1612,8 @@ void ProtocolGame::sendChannel(uint16_t channelId, const std::string& channelNam
 
 	if (channelUsers) {
 		msg.add<uint16_t>(channelUsers->size());
-		for (const auto& it : *channelUsers) {
-			msg.addString(it.second->getName());
+		for (const Player* user : *channelUsers) {
+			msg.addString(user->getName());
 		}
 	} else {
 		msg.add<uint16_t>(0x00);
@@ -1552,6 +1633,12 @@ void ProtocolGame::sendChannel(uint16_t channelId, const std::string& channelNam
 void ProtocolGame::sendChannelMessage(const std::string& author, const std::string& text, SpeakClasses type, uint16_t channel)
 {
 	NetworkMessage msg;
+	AddChannelMessage(msg, author, text, type, channel);
+	writeToOutputBuffer(msg);
+}
+
+void ProtocolGame::AddChannelMessage(NetworkMessage& msg, const std::string& author, const std::string& text, SpeakClasses type, uint16_t channel)
+{
 	msg.addByte(0xAA);
 	msg.add<uint32_t>(0x00);
 	msg.addString(author);
@@ -1559,7 +1646,6 @@ void ProtocolGame::sendChannelMessage(const std::string& author, const std::stri
 	msg.addByte(type);
 	msg.add<uint16_t>(channel);
 	msg.addString(text);
-	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendIcons(uint16_t icons)
@@ -2233,12 +2319,18 @@ void ProtocolGame::sendCreatureTurn(const Creature* creature, uint32_t stackPos)
 	msg.add<uint32_t>(creature->getID());
 	msg.addByte(creature->getDirection());
 	msg.addByte(player->canWalkthroughEx(creature) ? 0x00 : 0x01);
-	writeToOutputBuffer(msg);
+	writeToOutputBuffer(msg, PACKET_MOVEMENT);
 }
 
 void ProtocolGame::sendCreatureSay(const Creature* creature, SpeakClasses type, const std::string& text, const Position* pos/* = nullptr*/)
 {
 	NetworkMessage msg;
+	AddCreatureSay(msg, creature, type, text, pos);
+	writeToOutputBuffer(msg, getSpeechClass(type));
+}
+
+void ProtocolGame::AddCreatureSay(NetworkMessage& msg, const Creature* creature, SpeakClasses type, const std::string& text, const Position* pos)
+{
 	msg.addByte(0xAA);
 
 	static uint32_t statementId = 0;
@@ -2261,12 +2353,17 @@ void ProtocolGame::sendCreatureSay(const Creature* creature, SpeakClasses type,
 	}
 
 	msg.addString(text);
-	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendToChannel(const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId)
 {
 	NetworkMessage msg;
+	AddToChannel(msg, creature, type, text, channelId);
+	writeToOutputBuffer(msg);
+}
+
+void ProtocolGame::AddToChannel(NetworkMessage& msg, const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId)
+{
 	msg.addByte(0xAA);
 
 	static uint32_t statementId = 0;
@@ -2286,7 +2383,6 @@ void ProtocolGame::sendToChannel(const Creature* creature, SpeakClasses type, co
 	msg.addByte(type);
 	msg.add<uint16_t>(channelId);
 	msg.addString(text);
-	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendPrivateMessage(const Player* speaker, SpeakClasses type, const std::string& text)
@@ -2321,7 +2417,7 @@ void ProtocolGame::sendChangeSpeed(const Creature* creature, uint32_t speed)
 	msg.add<uint32_t>(creature->getID());
 	msg.add<uint16_t>(creature->getBaseSpeed() / 2);
 	msg.add<uint16_t>(speed / 2);
-	writeToOutputBuffer(msg);
+	writeToOutputBuffer(msg, PACKET_MOVEMENT);
 }
 
 void ProtocolGame::sendCancelWalk()
@@ -2329,7 +2425,7 @@ void ProtocolGame::sendCancelWalk()
 	NetworkMessage msg;
 	msg.addByte(0xB5);
 	msg.addByte(player->getDirection());
-	writeToOutputBuffer(msg);
+	writeToOutputBuffer(msg, PACKET_MOVEMENT);
 }
 
 void ProtocolGame::sendSkills()
@@ -2356,11 +2452,16 @@ void ProtocolGame::sendPingBack()
 void ProtocolGame::sendDistanceShoot(const Position& from, const Position& to, uint8_t type)
 {
 	NetworkMessage msg;
+	AddDistanceShoot(msg, from, to, type);
+	writeToOutputBuffer(msg, PACKET_COSMETIC);
+}
+
+void ProtocolGame::AddDistanceShoot(NetworkMessage& msg, const Position& from, const Position& to, uint8_t type)
+{
 	msg.addByte(0x85);
 	msg.addPosition(from);
 	msg.addPosition(to);
 	msg.addByte(type);
-	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendMagicEffect(const Position& pos, uint16_t type)
@@ -2370,15 +2471,26 @@ void ProtocolGame::sendMagicEffect(const Position& pos, uint16_t type)
 	}
 
 	NetworkMessage msg;
+	AddMagicEffect(msg, pos, type);
+	writeToOutputBuffer(msg, PACKET_COSMETIC);
+}
+
+void ProtocolGame::AddMagicEffect(NetworkMessage& msg, const Position& pos, uint16_t type)
+{
 	msg.addByte(0x83);
 	msg.addPosition(pos);
 	msg.add<uint16_t>(type);
-	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendCreatureHealth(const Creature* creature)
 {
 	NetworkMessage msg;
+	AddCreatureHealth(msg, creature);
+	writeToOutputBuffer(msg);
+}
+
+void ProtocolGame::AddCreatureHealth(NetworkMessage& msg, const Creature* creature)
+{
 	msg.addByte(0x8C);
 	msg.add<uint32_t>(creature->getID());
 
@@ -2387,7 +2499,6 @@ void ProtocolGame::sendCreatureHealth(const Creature* creature)
 	} else {
 		msg.addByte(std::ceil((static_cast<double>(creature->getHealth()) / std::max<int32_t>(creature->getMaxHealth(), 1)) * 100));
 	}
-	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendFYIBox(const std::string& message)
@@ -2511,7 +2622,7 @@ void ProtocolGame::sendRemoveTileCreature(const Creature* creature, const Positi
 
 		NetworkMessage msg;
 		RemoveTileThing(msg, pos, stackpos);
-		writeToOutputBuffer(msg);
+		writeToOutputBuffer(msg, PACKET_MOVEMENT);
 		return;
 	}
 
@@ -2519,7 +2630,7 @@ void ProtocolGame::sendRemoveTileCreature(const Creature* creature, const Positi
 	msg.addByte(0x6C);
 	msg.add<uint16_t>(0xFFFF);
 	msg.add<uint32_t>(creature->getID());
-	writeToOutputBuffer(msg);
+	writeToOutputBuffer(msg, PACKET_MOVEMENT);
 }
 
 void ProtocolGame::sendUpdateTile(const Tile* tile, const Position& pos)
@@ -2598,7 +2709,7 @@ void ProtocolGame::sendAddCreature(const Creature* creature, const Position& pos
 			uint32_t removedKnown;
 			checkCreatureAsKnown(creature->getID(), known, removedKnown);
 			AddCreature(msg, creature, known, removedKnown);
-			writeToOutputBuffer(msg);
+			writeToOutputBuffer(msg, PACKET_MOVEMENT);
 		}
 
 		if (isLogin) {
@@ -2704,7 +2815,7 @@ void ProtocolGame::sendMoveCreature(const Creature* creature, const Position& ne
 				msg.addByte(0x68);
 				GetMapDescription(newPos.x - awareRange.left(), newPos.y - awareRange.top(), newPos.z, 1, awareRange.vertical(), msg);
 			}
-			writeToOutputBuffer(msg);
+			writeToOutputBuffer(msg, PACKET_MOVEMENT);
 		}
 	} else if (canSee(oldPos) && canSee(creature->getPosition())) {
 		if (teleport || (oldPos.z == 7 && newPos.z >= 8)) {
@@ -2721,7 +2832,7 @@ void ProtocolGame::sendMoveCreature(const Creature* creature, const Position& ne
 				msg.add<uint32_t>(creature->getID());
 			}
 			msg.addPosition(creature->getPosition());
-			writeToOutputBuffer(msg);
+			writeToOutputBuffer(msg, PACKET_MOVEMENT);
 		}
 	} else if (canSee(oldPos)) {
 		sendRemoveTileCreature(creature, oldPos, oldStackPos);
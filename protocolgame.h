@@ -37,6 +37,40 @@ struct TextMessage
 	TextMessage(MessageClasses type, std::string text) : type(type), text(std::move(text)) {}
 };
 
+enum BroadcastType_t : uint8_t {
+	BROADCAST_CREATURESAY,
+	BROADCAST_DISTANCEEFFECT,
+	BROADCAST_MAGICEFFECT,
+
+	BROADCAST_LAST = BROADCAST_MAGICEFFECT
+};
+
+// Packets are classed by what the client loses when they are left out.
+// Cosmetic packets are dropped while a connection is over its send budget,
+// movement and critical state would desync the client and are always sent.
+enum PacketClass_t : uint8_t {
+	PACKET_CRITICAL,
+	PACKET_MOVEMENT,
+	PACKET_COSMETIC,
+
+	PACKET_CLASS_LAST = PACKET_COSMETIC
+};
+
+struct PacketClassStats {
+	uint64_t packets = 0;
+	uint64_t bytes = 0;
+	uint64_t droppedPackets = 0;
+	uint64_t droppedBytes = 0;
+};
+
+// recipients of a broadcast packet, suppressed ones were in spectator range
+// but could not see the position with their aware range
+struct BroadcastStats {
+	uint64_t sent = 0;
+	uint64_t suppressed = 0;
+	uint64_t bytesSaved = 0;
+};
+
 class ProtocolGame final : public Protocol
 {
 	public:
@@ -57,13 +91,47 @@ class ProtocolGame final : public Protocol
 			return version;
 		}
 
+		// viewer independent packets, Game encodes these once per broadcast
+		static void AddCreatureSay(NetworkMessage& msg, const Creature* creature, SpeakClasses type, const std::string& text, const Position* pos);
+		static void AddDistanceShoot(NetworkMessage& msg, const Position& from, const Position& to, uint8_t type);
+		static void AddMagicEffect(NetworkMessage& msg, const Position& pos, uint16_t type);
+		static void AddCreatureHealth(NetworkMessage& msg, const Creature* creature);
+		static void AddChannelMessage(NetworkMessage& msg, const std::string& author, const std::string& text, SpeakClasses type, uint16_t channel);
+		static void AddToChannel(NetworkMessage& msg, const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId);
+
+		static const TileItemsCacheStats& getTileCacheStats() {
+			return tileCacheStats;
+		}
+
+		static const BroadcastStats& getBroadcastStats(BroadcastType_t type) {
+			return broadcastStats[type];
+		}
+		static PacketClass_t getSpeechClass(SpeakClasses type) {
+			return (type == TALKTYPE_MONSTER_SAY || type == TALKTYPE_MONSTER_YELL) ? PACKET_COSMETIC : PACKET_CRITICAL;
+		}
+
+		static const PacketClassStats& getPacketStats(PacketClass_t packetClass) {
+			return packetStats[packetClass];
+		}
+
+		// bytes written for the client that are not on the wire yet
+		uint32_t getSendBacklog();
+
+		static void addBroadcastStats(BroadcastType_t type, uint32_t sent, uint32_t suppressed, size_t length) {
+			BroadcastStats& stats = broadcastStats[type];
+			stats.sent += sent;
+			stats.suppressed += suppressed;
+			stats.bytesSaved += suppressed * length;
+		}
+
 	private:
 		ProtocolGame_ptr getThis() {
 			return std::static_pointer_cast<ProtocolGame>(shared_from_this());
 		}
+		void finishLogin(OperatingSystem_t operatingSystem);
 		void connect(uint32_t playerId, OperatingSystem_t operatingSystem);
 		void disconnectClient(const std::string& message) const;
-		void writeToOutputBuffer(const NetworkMessage& msg);
+		void writeToOutputBuffer(const NetworkMessage& msg, PacketClass_t packetClass = PACKET_CRITICAL);
 
 		void release() override;
 
@@ -155,7 +223,7 @@ class ProtocolGame final : public Protocol
 		void sendClosePrivate(uint16_t channelId);
 		void sendCreatePrivateChannel(uint16_t channelId, const std::string& channelName);
 		void sendChannelsDialog();
-		void sendChannel(uint16_t channelId, const std::string& channelName, const UsersMap* channelUsers, const InvitedMap* invitedUsers);
+		void sendChannel(uint16_t channelId, const std::string& channelName, const UsersList* channelUsers, const InvitedMap* invitedUsers);
 		void sendOpenPrivateChannel(const std::string& receiver);
 		void sendToChannel(const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId);
 		void sendPrivateMessage(const Player* speaker, SpeakClasses type, const std::string& text);
@@ -276,6 +344,7 @@ class ProtocolGame final : public Protocol
 
 		// translate a tile to client-readable format
 		void GetTileDescription(const Tile* tile, NetworkMessage& msg);
+		static const TileItemsCache& getTileItemsCache(const Tile* tile);
 
 		// translate a floor to client-readable format
 		void GetFloorDescription(NetworkMessage& msg, int32_t x, int32_t y, int32_t z,
@@ -325,6 +394,10 @@ class ProtocolGame final : public Protocol
 			g_dispatcher.addTask(createTask(delay, std::bind(std::forward<Callable>(function), &g_game, std::forward<Args>(args)...)));
 		}
 
+		static TileItemsCacheStats tileCacheStats;
+		static std::array<BroadcastStats, BROADCAST_LAST + 1> broadcastStats;
+		static std::array<PacketClassStats, PACKET_CLASS_LAST + 1> packetStats;
+
 		std::unordered_set<uint32_t> knownCreatureSet;
 		Player* player = nullptr;
 
@@ -6,31 +6,31 @@
 #include "script.h"
 #include <boost/filesystem.hpp>
 #include "configmanager.h"
+#include "actions.h"
+#include "talkaction.h"
+#include "spells.h"
+#include "movement.h"
+#include "weapons.h"
+#include "globalevent.h"
+#include "creatureevent.h"
+#include "scheduler.h"
 
 extern LuaEnvironment g_luaEnvironment;
 extern ConfigManager g_config;
+extern Actions* g_actions;
+extern CreatureEvents* g_creatureEvents;
+extern GlobalEvents* g_globalEvents;
+extern MoveEvents* g_moveEvents;
+extern Spells* g_spells;
+extern TalkActions* g_talkActions;
+extern Weapons* g_weapons;
 
-Scripts::Scripts() :
-	scriptInterface("Scripts Interface")
-{
-	scriptInterface.initState();
-}
+namespace fs = boost::filesystem;
 
-Scripts::~Scripts()
-{
-	scriptInterface.reInitState();
-}
+namespace {
 
-bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
+std::vector<fs::path> getScriptFiles(const fs::path& dir, bool isLib, bool showDisabled)
 {
-	namespace fs = boost::filesystem;
-
-	const auto dir = fs::current_path() / "data" / folderName;
-	if(!fs::exists(dir) || !fs::is_directory(dir)) {
-		std::cout << "[Warning - Scripts::loadScripts] Can not load folder '" << folderName << "'." << std::endl;
-		return false;
-	}
-
 	fs::recursive_directory_iterator endit;
 	std::vector<fs::path> v;
 	std::string disable = ("#");
@@ -42,7 +42,7 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 		if(fs::is_regular_file(*it) && it->path().extension() == ".lua") {
 			size_t found = it->path().filename().string().find(disable);
 			if (found != std::string::npos) {
-				if (g_config.getBoolean(ConfigManager::SCRIPTS_CONSOLE_LOGS)) {
+				if (showDisabled && g_config.getBoolean(ConfigManager::SCRIPTS_CONSOLE_LOGS)) {
 					std::cout << "> " << it->path().filename().string() << " [disabled]" << std::endl;
 				}
 				continue;
@@ -51,6 +51,40 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 		}
 	}
 	sort(v.begin(), v.end());
+	return v;
+}
+
+std::time_t getWriteTime(const std::string& scriptFile)
+{
+	boost::system::error_code ec;
+	std::time_t writeTime = fs::last_write_time(scriptFile, ec);
+	return ec ? 0 : writeTime;
+}
+
+}
+
+Scripts::Scripts() :
+	scriptInterface("Scripts Interface")
+{
+	scriptInterface.initState();
+}
+
+Scripts::~Scripts()
+{
+	scriptInterface.reInitState();
+}
+
+bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
+{
+	const auto dir = fs::current_path() / "data" / folderName;
+	if(!fs::exists(dir) || !fs::is_directory(dir)) {
+		std::cout << "[Warning - Scripts::loadScripts] Can not load folder '" << folderName << "'." << std::endl;
+		return false;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	std::vector<fs::path> v = getScriptFiles(dir, isLib, true);
 	std::string redir;
 	for (auto it = v.begin(); it != v.end(); ++it) {
 		const std::string scriptFile = it->string();
@@ -62,6 +96,8 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 				}
 				redir = it->parent_path().string();
 			}
+
+			scriptFiles[scriptFile] = getWriteTime(scriptFile);
 		}
 
 		if(scriptInterface.loadFile(scriptFile) == -1) {
@@ -79,5 +115,100 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 		}
 	}
 
+	if (!isLib) {
+		watchedFolders.insert(folderName);
+	}
+
+	if (reload) {
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+		std::cout << ">> Reloaded " << v.size() << " scripts from " << folderName << " in " << duration << " ms" << std::endl;
+	}
 	return true;
 }
+
+void Scripts::unregisterScript(const std::string& scriptFile)
+{
+	g_actions->clearScriptFile(scriptFile);
+	g_creatureEvents->clearScriptFile(scriptFile);
+	g_moveEvents->clearScriptFile(scriptFile);
+	g_talkActions->clearScriptFile(scriptFile);
+	g_globalEvents->clearScriptFile(scriptFile);
+	g_weapons->clearScriptFile(scriptFile);
+	g_spells->clearScriptFile(scriptFile);
+}
+
+bool Scripts::reloadScript(const std::string& scriptFile)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	unregisterScript(scriptFile);
+	scriptFiles[scriptFile] = getWriteTime(scriptFile);
+
+	bool success = scriptInterface.loadFile(scriptFile) != -1;
+
+	// restore the default weapons that a removed lua weapon may have replaced
+	g_weapons->loadDefaults();
+
+	auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+	const std::string fileName = fs::path(scriptFile).filename().string();
+	if (!success) {
+		std::cout << "> " << fileName << " [error]" << std::endl;
+		std::cout << "^ " << scriptInterface.getLastLuaError() << std::endl;
+		return false;
+	}
+
+	std::cout << "> " << fileName << " [reloaded in " << duration / 1000. << " ms]" << std::endl;
+	return true;
+}
+
+void Scripts::startWatcher()
+{
+	if (watcherEventId != 0) {
+		g_scheduler.stopEvent(watcherEventId);
+		watcherEventId = 0;
+	}
+
+	int32_t interval = g_config.getNumber(ConfigManager::SCRIPTS_WATCH_INTERVAL);
+	if (interval <= 0) {
+		return;
+	}
+
+	watcherEventId = g_scheduler.addEvent(createSchedulerTask(std::max<int32_t>(SCHEDULER_MINTICKS, interval), [this]() {
+		watcherEventId = 0;
+		checkModifiedScripts();
+		startWatcher();
+	}));
+}
+
+void Scripts::checkModifiedScripts()
+{
+	std::set<std::string> existingFiles;
+	for (const std::string& folderName : watchedFolders) {
+		const auto dir = fs::current_path() / "data" / folderName;
+		if (!fs::is_directory(dir)) {
+			continue;
+		}
+
+		for (const fs::path& path : getScriptFiles(dir, false, false)) {
+			const std::string scriptFile = path.string();
+			existingFiles.insert(scriptFile);
+
+			auto it = scriptFiles.find(scriptFile);
+			if (it == scriptFiles.end() || it->second != getWriteTime(scriptFile)) {
+				reloadScript(scriptFile);
+			}
+		}
+	}
+
+	for (auto it = scriptFiles.begin(); it != scriptFiles.end(); ) {
+		if (existingFiles.find(it->first) != existingFiles.end()) {
+			++it;
+			continue;
+		}
+
+		unregisterScript(it->first);
+		g_weapons->loadDefaults();
+		std::cout << "> " << fs::path(it->first).filename().string() << " [unloaded]" << std::endl;
+		it = scriptFiles.erase(it);
+	}
+}
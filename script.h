@@ -4,6 +4,8 @@
 #ifndef FS_SCRIPTS_H
 #define FS_SCRIPTS_H
 
+#include <set>
+
 #include "luascript.h"
 #include "enums.h"
 
@@ -14,11 +16,23 @@ class Scripts
 		~Scripts();
 
 		bool loadScripts(std::string folderName, bool isLib, bool reload);
+		bool reloadScript(const std::string& scriptFile);
+
+		void startWatcher();
+		void checkModifiedScripts();
+
 		LuaScriptInterface& getScriptInterface() {
 			return scriptInterface;
 		}
 	private:
+		void unregisterScript(const std::string& scriptFile);
+
 		LuaScriptInterface scriptInterface;
+
+		// last write time of every loaded script, libs excluded
+		std::map<std::string, std::time_t> scriptFiles;
+		std::set<std::string> watchedFolders;
+		uint32_t watcherEventId = 0;
 };
 
 #endif
@@ -23,6 +23,7 @@
 #include "events.h"
 #include "scheduler.h"
 #include "databasetasks.h"
+#include "luaprofiler.h"
 
 extern Scheduler g_scheduler;
 extern DatabaseTasks g_databaseTasks;
@@ -52,6 +53,22 @@ void sigusr1Handler()
 	g_game.saveGameState();
 }
 
+void sigusr2Handler()
+{
+	//Dispatcher thread
+	if (!g_luaProfiler.isEnabled()) {
+		std::cout << "SIGUSR2 received, starting lua profiler..." << std::endl;
+		g_luaProfiler.reset();
+		g_luaProfiler.start(1000);
+		return;
+	}
+
+	std::cout << "SIGUSR2 received, stopping lua profiler and dumping results to " << LUA_PROFILER_DUMP_FILE << "..." << std::endl;
+	g_luaProfiler.stop();
+	g_luaProfiler.printSummary();
+	g_luaProfiler.dump(LUA_PROFILER_DUMP_FILE);
+}
+
 void sighupHandler()
 {
 	//Dispatcher thread
@@ -160,6 +177,9 @@ void dispatchSignalHandler(int signal)
 		case SIGUSR1: //Saves game state
 			g_dispatcher.addTask(createTask(sigusr1Handler));
 			break;
+		case SIGUSR2: //Toggles the lua profiler
+			g_dispatcher.addTask(createTask(sigusr2Handler));
+			break;
 #else
 		case SIGBREAK: //Shuts the server down
 			g_dispatcher.addTask(createTask(sigbreakHandler));
@@ -182,6 +202,7 @@ Signals::Signals(boost::asio::io_service& service): set(service)
 	set.add(SIGTERM);
 #ifndef _WIN32
 	set.add(SIGUSR1);
+	set.add(SIGUSR2);
 	set.add(SIGHUP);
 #else
 	// This must be a blocking call as Windows calls it in a new thread and terminates
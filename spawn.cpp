@@ -190,6 +190,8 @@ bool Spawns::loadFromXml(const std::string& filename)
 			}
 		}
 	}
+
+	Npcs::printScriptStats();
 	return true;
 }
 
@@ -238,11 +240,19 @@ bool Spawns::isInZone(const Position& centerPos, int32_t radius, const Position&
 
 void Spawn::startSpawnCheck()
 {
-	if (checkSpawnEvent == 0) {
-		checkSpawnEvent = g_scheduler.addEvent(createSchedulerTask(getInterval(), std::bind(&Spawn::checkSpawn, this)));
+	// a check sleeping until a later block is due is brought forward
+	if (checkSpawnEvent == 0 || nextSpawnCheck > OTSYS_TIME() + getInterval()) {
+		scheduleSpawnCheck(getInterval());
 	}
 }
 
+void Spawn::scheduleSpawnCheck(int64_t delay)
+{
+	stopEvent();
+	nextSpawnCheck = OTSYS_TIME() + delay;
+	checkSpawnEvent = g_scheduler.addEvent(createSchedulerTask(delay, std::bind(&Spawn::checkSpawn, this)));
+}
+
 Spawn::~Spawn()
 {
 	for (const auto& it : spawnedMap) {
@@ -254,14 +264,13 @@ Spawn::~Spawn()
 
 bool Spawn::findPlayer(const Position& pos)
 {
-	SpectatorVec spectators;
-	g_game.map.getSpectators(spectators, pos, false, true);
-	for (Creature* spectator : spectators) {
-		if (!spectator->getPlayer()->hasFlag(PlayerFlag_IgnoredByMonsters)) {
-			return true;
-		}
-	}
-	return false;
+	return g_game.map.isPlayerNearby(pos);
+}
+
+void Spawn::queueRespawn(uint32_t spawnId)
+{
+	const spawnBlock_t& sb = spawnMap[spawnId];
+	respawnQueue.emplace(sb.lastSpawn + sb.interval, spawnId);
 }
 
 bool Spawn::isInSpawnZone(const Position& pos)
@@ -342,7 +351,9 @@ void Spawn::startup()
 	for (const auto& it : spawnMap) {
 		uint32_t spawnId = it.first;
 		const spawnBlock_t& sb = it.second;
-		spawnMonster(spawnId, sb, true);
+		if (!spawnMonster(spawnId, sb, true)) {
+			queueRespawn(spawnId);
+		}
 	}
 }
 
@@ -352,30 +363,46 @@ void Spawn::checkSpawn()
 
 	cleanup();
 
+	const uint32_t maxSpawnCount = g_config.getNumber(ConfigManager::RATE_SPAWN);
 	uint32_t spawnCount = 0;
+	bool rateLimited = false;
 
-	for (auto& it : spawnMap) {
-		uint32_t spawnId = it.first;
-		if (spawnedMap.find(spawnId) != spawnedMap.end()) {
+	// blocks retried in this check go back into the queue afterwards
+	std::vector<uint32_t> retries;
+
+	int64_t now = OTSYS_TIME();
+	while (!respawnQueue.empty() && respawnQueue.begin()->first <= now) {
+		uint32_t spawnId = respawnQueue.begin()->second;
+		respawnQueue.erase(respawnQueue.begin());
+
+		spawnBlock_t& sb = spawnMap[spawnId];
+		if (!spawnMonster(spawnId, sb)) {
+			sb.lastSpawn = now;
+			retries.push_back(spawnId);
 			continue;
 		}
 
-		spawnBlock_t& sb = it.second;
-		if (OTSYS_TIME() >= sb.lastSpawn + sb.interval) {
-			if (!spawnMonster(spawnId, sb)) {
-				sb.lastSpawn = OTSYS_TIME();
-				continue;
-			}
-
-			if (++spawnCount >= static_cast<uint32_t>(g_config.getNumber(ConfigManager::RATE_SPAWN))) {
-				break;
-			}
+		// at least one block spawns per check, even with a rate of 0
+		if (++spawnCount >= maxSpawnCount) {
+			rateLimited = !respawnQueue.empty() && respawnQueue.begin()->first <= now;
+			break;
 		}
 	}
 
-	if (spawnedMap.size() < spawnMap.size()) {
-		checkSpawnEvent = g_scheduler.addEvent(createSchedulerTask(getInterval(), std::bind(&Spawn::checkSpawn, this)));
+	for (uint32_t spawnId : retries) {
+		queueRespawn(spawnId);
+	}
+
+	if (respawnQueue.empty()) {
+		return;
+	}
+
+	int64_t delay = getInterval();
+	if (!rateLimited) {
+		// sleep until the next block is due
+		delay = std::max<int64_t>(respawnQueue.begin()->first - OTSYS_TIME(), EVENT_CREATURE_THINK_INTERVAL);
 	}
+	scheduleSpawnCheck(delay);
 }
 
 void Spawn::cleanup()
@@ -387,9 +414,13 @@ void Spawn::cleanup()
 		if (monster->isRemoved()) {
 			monster->decrementReferenceCounter();
 			it = spawnedMap.erase(it);
+			if (spawnId != 0) {
+				queueRespawn(spawnId);
+			}
 		} else if (!isInSpawnZone(monster->getPosition()) && spawnId != 0) {
 			spawnedMap.insert({0, monster});
 			it = spawnedMap.erase(it);
+			queueRespawn(spawnId);
 		} else {
 			++it;
 		}
@@ -426,8 +457,12 @@ void Spawn::removeMonster(Monster* monster)
 {
 	for (auto it = spawnedMap.begin(), end = spawnedMap.end(); it != end; ++it) {
 		if (it->second == monster) {
+			uint32_t spawnId = it->first;
 			monster->decrementReferenceCounter();
 			spawnedMap.erase(it);
+			if (spawnId != 0) {
+				queueRespawn(spawnId);
+			}
 			break;
 		}
 	}
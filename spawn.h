@@ -55,13 +55,19 @@ class Spawn
 		//map of creatures in the spawn
 		std::map<uint32_t, spawnBlock_t> spawnMap;
 
+		//blocks without a monster by the time their interval elapses, checks only wake the due ones
+		std::multimap<int64_t, uint32_t> respawnQueue;
+
 		Position centerPos;
 		int32_t radius;
 
 		uint32_t interval = 60000;
 		uint32_t checkSpawnEvent = 0;
+		int64_t nextSpawnCheck = 0;
 
 		static bool findPlayer(const Position& pos);
+		void queueRespawn(uint32_t spawnId);
+		void scheduleSpawnCheck(int64_t delay);
 		bool spawnMonster(uint32_t spawnId, spawnBlock_t sb, bool startup = false);
 		bool spawnMonster(uint32_t spawnId, MonsterType* mType, const Position& pos, Direction dir, bool startup = false);
 		void checkSpawn();
@@ -0,0 +1,30 @@
+// Copyright 2022 The Forgotten Server Authors. All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "spectators.h"
+#include "creature.h"
+
+uint64_t SpectatorVec::markCounter = 0;
+
+void SpectatorVec::addSpectators(const SpectatorVec& spectators)
+{
+	if (spectators.empty()) {
+		return;
+	}
+
+	// stamp the current members once, then every incoming creature is a
+	// single compare instead of a search through vec
+	const uint64_t mark = ++markCounter;
+	for (Creature* spectator : vec) {
+		spectator->spectatorMark = mark;
+	}
+
+	for (Creature* spectator : spectators.vec) {
+		if (spectator->spectatorMark != mark) {
+			spectator->spectatorMark = mark;
+			vec.emplace_back(spectator);
+		}
+	}
+}
@@ -18,15 +18,8 @@ public:
 		vec.reserve(32);
 	}
 
-	void addSpectators(const SpectatorVec& spectators) {
-		for (Creature* spectator : spectators.vec) {
-			auto it = std::find(vec.begin(), vec.end(), spectator);
-			if (it != end()) {
-				continue;
-			}
-			vec.emplace_back(spectator);
-		}
-	}
+	// linear in the size of both vectors, dispatcher thread only
+	void addSpectators(const SpectatorVec& spectators);
 
 	void erase(Creature* spectator) {
 		auto it = std::find(vec.begin(), vec.end(), spectator);
@@ -46,6 +39,8 @@ public:
 	void emplace_back(Creature* c) { vec.emplace_back(c); }
 
 private:
+	static uint64_t markCounter;
+
 	Vec vec;
 };
 
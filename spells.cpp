@@ -107,6 +107,25 @@ void Spells::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void Spells::clearScriptFile(const std::string& scriptFile)
+{
+	for (auto instant = instants.begin(); instant != instants.end(); ) {
+		if (instant->second.fromLua && instant->second.scriptFile == scriptFile) {
+			instant = instants.erase(instant);
+		} else {
+			++instant;
+		}
+	}
+
+	for (auto rune = runes.begin(); rune != runes.end(); ) {
+		if (rune->second.fromLua && rune->second.scriptFile == scriptFile) {
+			rune = runes.erase(rune);
+		} else {
+			++rune;
+		}
+	}
+}
+
 LuaScriptInterface& Spells::getScriptInterface()
 {
 	return scriptInterface;
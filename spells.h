@@ -46,6 +46,7 @@ class Spells final : public BaseEvents
 
 		void clearMaps(bool fromLua);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 		bool registerInstantLuaEvent(InstantSpell* event);
 		bool registerRuneLuaEvent(RuneSpell* event);
 
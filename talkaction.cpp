@@ -31,6 +31,17 @@ void TalkActions::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void TalkActions::clearScriptFile(const std::string& scriptFile)
+{
+	for (auto it = talkActions.begin(); it != talkActions.end(); ) {
+		if (it->second.fromLua && it->second.scriptFile == scriptFile) {
+			it = talkActions.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 LuaScriptInterface& TalkActions::getScriptInterface()
 {
 	return scriptInterface;
@@ -84,6 +84,7 @@ class TalkActions final : public BaseEvents
 
 		bool registerLuaEvent(TalkAction* event);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 
 	private:
 		LuaScriptInterface& getScriptInterface() override;
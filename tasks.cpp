@@ -27,6 +27,18 @@ void Dispatcher::threadMain()
 	while (getState() != THREAD_STATE_TERMINATED) {
 		// check if there are tasks waiting
 		taskLockUnique.lock();
+		if (taskList.empty() && idleHandler) {
+			// use the spare time, but give way as soon as a task arrives
+			do {
+				taskLockUnique.unlock();
+				bool moreWork = idleHandler();
+				taskLockUnique.lock();
+				if (!moreWork) {
+					break;
+				}
+			} while (taskList.empty());
+		}
+
 		if (taskList.empty()) {
 			//if the list is empty wait for signal
 			taskSignal.wait(taskLockUnique);
@@ -59,9 +59,17 @@ class Dispatcher : public ThreadHolder<Dispatcher> {
 			return dispatcherCycle;
 		}
 
+		// called from the dispatcher thread while no task is queued, the
+		// handler returns true as long as it has more work to do
+		void setIdleHandler(std::function<bool(void)> handler) {
+			idleHandler = std::move(handler);
+		}
+
 		void threadMain();
 
 	private:
+		std::function<bool(void)> idleHandler;
+
 		std::mutex taskLock;
 		std::condition_variable taskSignal;
 
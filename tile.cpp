@@ -21,6 +21,13 @@ extern Game g_game;
 extern MoveEvents* g_moveEvents;
 extern ConfigManager g_config;
 
+namespace {
+
+// tiles holding an items cache, most recently described first
+std::list<const Tile*> itemsCacheTiles;
+
+}
+
 StaticTile real_nullptr_tile(0xFFFF, 0xFFFF, 0xFF);
 Tile& Tile::nullptr_tile = real_nullptr_tile;
 
@@ -346,8 +353,54 @@ Thing* Tile::getTopVisibleThing(const Creature* creature)
 	return ground;
 }
 
+TileItemsCache* Tile::getItemsCache() const
+{
+	if (itemsCache) {
+		itemsCacheTiles.splice(itemsCacheTiles.begin(), itemsCacheTiles, itemsCache->lruPosition);
+	}
+	return itemsCache.get();
+}
+
+TileItemsCache& Tile::makeItemsCache(TileItemsCacheStats& stats) const
+{
+	if (itemsCache) {
+		return *itemsCache;
+	}
+
+	while (itemsCacheTiles.size() >= TILE_ITEMS_CACHE_LIMIT) {
+		itemsCacheTiles.back()->resetItemsCache();
+		++stats.evictions;
+	}
+
+	itemsCache.reset(new TileItemsCache);
+	itemsCache->lruPosition = itemsCacheTiles.insert(itemsCacheTiles.begin(), this);
+	return *itemsCache;
+}
+
+void Tile::resetItemsCache() const
+{
+	if (itemsCache) {
+		itemsCacheTiles.erase(itemsCache->lruPosition);
+		itemsCache.reset();
+	}
+}
+
+void Tile::clearItemsCaches()
+{
+	while (!itemsCacheTiles.empty()) {
+		itemsCacheTiles.front()->resetItemsCache();
+	}
+}
+
+size_t Tile::getItemsCacheCount()
+{
+	return itemsCacheTiles.size();
+}
+
 void Tile::onAddTileItem(Item* item)
 {
+	resetItemsCache();
+
 	if (item->hasProperty(CONST_PROP_MOVEABLE) || item->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -384,6 +437,8 @@ void Tile::onAddTileItem(Item* item)
 
 void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newItem, const ItemType& newType)
 {
+	resetItemsCache();
+
 	if (newItem->hasProperty(CONST_PROP_MOVEABLE) || newItem->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -422,6 +477,8 @@ void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newIte
 
 void Tile::onRemoveTileItem(const SpectatorVec& spectators, const std::vector<int32_t>& oldStackPosVector, Item* item)
 {
+	resetItemsCache();
+
 	if (item->hasProperty(CONST_PROP_MOVEABLE) || item->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -470,6 +527,8 @@ void Tile::onRemoveTileItem(const SpectatorVec& spectators, const std::vector<in
 
 void Tile::onUpdateTile(const SpectatorVec& spectators)
 {
+	resetItemsCache();
+
 	const Position& cylinderMapPos = getPosition();
 
 	//send to clients
@@ -1427,6 +1486,8 @@ void Tile::internalAddThing(uint32_t, Thing* thing)
 			return;
 		}
 
+		resetItemsCache();
+
 		const ItemType& itemType = Item::items[item->getID()];
 		if (itemType.isGroundTile()) {
 			if (ground == nullptr) {
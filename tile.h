@@ -20,6 +20,30 @@ class BedItem;
 using CreatureVector = std::vector<Creature*>;
 using ItemVector = std::vector<Item*>;
 
+class Tile;
+
+// Client encoding of the items on a tile, built by ProtocolGame on first use
+// and dropped whenever the item stack changes. Creatures are always encoded
+// per viewer. At most TILE_ITEMS_CACHE_LIMIT tiles keep one, the least
+// recently described tile loses its cache first.
+static constexpr size_t TILE_ITEMS_CACHE_LIMIT = 65536;
+
+struct TileItemsCache {
+	std::list<const Tile*>::iterator lruPosition;
+	std::vector<uint8_t> buffer; // ground and top items followed by down items
+	std::array<uint16_t, 10> downItemEnd; // buffer offset behind each down item
+	uint16_t topItemsEnd = 0;
+	uint8_t topItemCount = 0;
+	uint8_t downItemCount = 0;
+};
+
+struct TileItemsCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t bytesServed = 0; // bytes copied from a cache hit
+	uint64_t evictions = 0; // caches dropped to stay within the limit
+};
+
 enum tileflags_t : uint32_t {
 	TILESTATE_NONE = 0,
 
@@ -136,9 +160,17 @@ class Tile : public Cylinder
 		static Tile& nullptr_tile;
 		Tile(uint16_t x, uint16_t y, uint8_t z) : tilePos(x, y, z) {}
 		virtual ~Tile() {
+			resetItemsCache();
 			delete ground;
 		};
 
+		static void* operator new(size_t size) {
+			return ObjectPool::getTilePool().allocate(size);
+		}
+		static void operator delete(void* p, size_t size) {
+			ObjectPool::getTilePool().deallocate(p, size);
+		}
+
 		// non-copyable
 		Tile(const Tile&) = delete;
 		Tile& operator=(const Tile&) = delete;
@@ -264,8 +296,18 @@ class Tile : public Cylinder
 		}
 		void setGround(Item* item) {
 			ground = item;
+			resetItemsCache();
 		}
 
+		// dispatcher thread only, except resetItemsCache on a tile without cache
+		TileItemsCache* getItemsCache() const;
+		TileItemsCache& makeItemsCache(TileItemsCacheStats& stats) const;
+		void resetItemsCache() const;
+
+		// drops the cache of every tile, e.g. after the client ids changed
+		static void clearItemsCaches();
+		static size_t getItemsCacheCount();
+
 	private:
 		void onAddTileItem(Item* item);
 		void onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newItem, const ItemType& newType);
@@ -276,6 +318,7 @@ class Tile : public Cylinder
 		void resetTileFlags(const Item* item);
 
 		Item* ground = nullptr;
+		mutable std::unique_ptr<TileItemsCache> itemsCache;
 		Position tilePos;
 		uint32_t flags = 0;
 };
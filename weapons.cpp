@@ -50,6 +50,18 @@ void Weapons::clear(bool fromLua)
 	reInitState(fromLua);
 }
 
+void Weapons::clearScriptFile(const std::string& scriptFile)
+{
+	for (auto it = weapons.begin(); it != weapons.end(); ) {
+		if (it->second->fromLua && it->second->scriptFile == scriptFile) {
+			delete it->second;
+			it = weapons.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 LuaScriptInterface& Weapons::getScriptInterface()
 {
 	return scriptInterface;
@@ -38,6 +38,7 @@ class Weapons final : public BaseEvents
 
 		bool registerLuaEvent(Weapon* event);
 		void clear(bool fromLua) override final;
+		void clearScriptFile(const std::string& scriptFile) override final;
 
 	private:
 		LuaScriptInterface& getScriptInterface() override;